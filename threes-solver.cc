@@ -19,22 +19,51 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <limits>
+#include <map>
 #include <sstream>
+#include <thread>
 #include <random>
 #include <vector>
 #include <unordered_map>
 
 #include <cctype>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
 
 #ifdef EMSCRIPTEN
 #include <emscripten.h>
 #endif
 
+#if defined(THREES_SEARCH_STATS) && defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(EMSCRIPTEN) && defined(__GNUC__)
+#define THREES_X86_SIMD
+#include <immintrin.h>
+#endif
+
 enum class PlayerMove {
   UNKNOWN,
   SWIPE_UP,
@@ -196,6 +225,86 @@ next_color_to_human_string(NextColor nc) {
   }
 }
 
+// what's left of the 12 card deck the game draws its 1s, 2s and 3s
+// from, the next card included unless it's a bonus card. a deck
+// that isn't tracked is all zeros and lets any card come next
+struct Deck {
+  uint8_t ones;
+  uint8_t twos;
+  uint8_t threes;
+
+  static
+  Deck
+  untracked() {
+    return {0, 0, 0};
+  }
+
+  static
+  Deck
+  fresh() {
+    return {4, 4, 4};
+  }
+
+  bool
+  tracked() const {
+    return ones || twos || threes;
+  }
+
+  // bonus cards only show up once the max card is 48, and then
+  // anything from 6 up to an eighth of the max card
+  static
+  bool
+  bonus_cards_possible(unsigned max_value) {
+    return max_value >= 48;
+  }
+
+  static
+  unsigned
+  max_bonus_card(unsigned max_value) {
+    return max_value / 8;
+  }
+
+  // whether the next card can be `nc`
+  bool
+  can_show(NextColor nc, unsigned max_value) const {
+    if (!tracked()) return true;
+    switch (nc) {
+    case NextColor::BLUE: return ones;
+    case NextColor::RED: return twos;
+    case NextColor::WHITE: return threes || bonus_cards_possible(max_value);
+    default: assert(false); return false;
+    }
+  }
+
+  // the deck once `card` is placed, which starts over when it runs
+  // out. a card the deck doesn't have means it was out of sync with
+  // the game, so it starts over then too
+  Deck
+  placed(const Card & card) const {
+    if (!tracked() || card.value() > 3) return *this;
+    auto toret = *this;
+    auto count = (card.value() == 1 ? &toret.ones :
+                  card.value() == 2 ? &toret.twos :
+                  &toret.threes);
+    if (!*count) return fresh().placed(card);
+    --*count;
+    return toret.tracked() ? toret : fresh();
+  }
+
+  // the same once `nc` is shown next as well, which also
+  // starts over if the deck can't have it
+  Deck
+  after(const Card & card, NextColor nc, unsigned max_value) const {
+    auto toret = placed(card);
+    return toret.can_show(nc, max_value) ? toret : fresh();
+  }
+
+  bool
+  operator==(const Deck & b) const {
+    return ones == b.ones && twos == b.twos && threes == b.threes;
+  }
+};
+
 class Board {
 public:
   const static size_t BOARD_SIZE = 4;
@@ -204,6 +313,7 @@ public:
 private:
   Card board[BOARD_ELTS];
   NextColor nc;
+  Deck _deck;
 
 public:
   static
@@ -292,7 +402,7 @@ private:
 
 public:
   template <class Range>
-  Board(const Range & r, NextColor nc_) : nc(nc_) {
+  Board(const Range & r, NextColor nc_, Deck deck_ = Deck::untracked()) : nc(nc_), _deck(deck_) {
     for (const auto & cp : r) {
       if (!is_valid_card_position(cp.position)) throw std::runtime_error("bad card position");
       if ((*this)[cp.position] != nullcard) throw std::runtime_error("same card twice!");
@@ -305,6 +415,16 @@ public:
     return nc;
   }
 
+  const Deck &
+  deck() const {
+    return _deck;
+  }
+
+  void
+  set_deck(const Deck & deck_) {
+    _deck = deck_;
+  }
+
   const Card &
   operator[](const CardPosition & pos) const {
     assert(is_valid_card_position(pos));
@@ -350,6 +470,7 @@ public:
     if ((*this)[cp.position] != nullcard) throw std::runtime_error("can't place card there");
     (*this)[cp.position] = cp.card;
     nc = nc_;
+    if (_deck.tracked()) _deck = _deck.after(cp.card, nc, max_card().value());
   }
 
   Card
@@ -395,6 +516,367 @@ public:
   }
 };
 
+// move generation for BitBoard is driven by tables indexed by a
+// 16-bit "line": the four 4-bit ranks of a row or column, with the
+// card on the edge we are shifting towards in the low nibble.
+// the tables are built when the program starts, as constants they
+// take more evaluation steps than clang and emcc allow by default
+
+typedef uint16_t line_type;
+
+const unsigned MAX_CARD_RANK = 15;
+const unsigned LINE_TABLE_SIZE = 1 << 16;
+
+// rank of the card that results from shifting `from` onto `onto`,
+// or 0 if it can't be shifted there
+constexpr
+unsigned
+shifted_rank(unsigned from, unsigned onto) {
+  return (!from ? 0 :
+          !onto ? from :
+          from + onto == 3 ? 3 :
+          // two 12288s would overflow our nibble, treat them as stuck
+          from == onto && from >= 3 && from < MAX_CARD_RANK ? from + 1 :
+          0);
+}
+
+constexpr
+unsigned
+line_rank(unsigned line, unsigned i) {
+  return (line >> (i * 4)) & 0xf;
+}
+
+constexpr
+line_type
+reverse_line(line_type line) {
+  return ((line & 0xf) << 12) | ((line & 0xf0) << 4) |
+    ((line >> 4) & 0xf0) | (line >> 12);
+}
+
+template <class T>
+struct LineTable {
+  T entries[LINE_TABLE_SIZE];
+
+  constexpr
+  const T &
+  operator[](line_type line) const {
+    return entries[line];
+  }
+};
+
+template <class T>
+LineTable<T>
+make_line_table(T (*compute)(unsigned)) {
+  LineTable<T> table{};
+  for (unsigned line = 0; line < LINE_TABLE_SIZE; ++line) {
+    table.entries[line] = compute(line);
+  }
+  return table;
+}
+
+struct LineShift {
+  // the line after shifting it towards its low nibble
+  line_type line;
+  bool moved;
+  uint8_t merges;
+};
+
+constexpr
+LineShift
+compute_line_shift(unsigned line) {
+  // this is the same walk as Board::_shift_inner does for each line
+  LineShift toret{line_type(line), false, 0};
+  for (unsigned j = 1; j < 4; ++j) {
+    auto from = line_rank(toret.line, j);
+    auto onto = line_rank(toret.line, j - 1);
+    auto shifted = shifted_rank(from, onto);
+    if (!shifted) continue;
+    toret.line &= ~((0xf << (j * 4)) | (0xf << ((j - 1) * 4)));
+    toret.line |= shifted << ((j - 1) * 4);
+    toret.moved = true;
+    if (onto) toret.merges += 1;
+  }
+  return toret;
+}
+
+const LineTable<LineShift> line_shift_table = make_line_table(compute_line_shift);
+
+// card_friction() in terms of ranks, no logs needed
+constexpr
+unsigned
+rank_friction(unsigned a, unsigned b) {
+  return (a > b ? rank_friction(b, a) :
+          !a ? 0 :
+          a < 3 && b < 3 ? (a == b ? 2 : 0) :
+          a < 3 ? 1 + b - 3 :
+          b - a);
+}
+
+struct LineEval {
+  // sum of the friction between the 3 adjacent pairs of the line
+  uint8_t friction;
+  uint8_t max_rank;
+  // whether the line moves when shifted towards its low nibble
+  // and towards its high nibble, so a leaf needs no shifts to know
+  // if the game is over
+  bool moves_low;
+  bool moves_high;
+};
+
+constexpr
+LineEval
+compute_line_eval(unsigned line) {
+  LineEval toret{0, 0, compute_line_shift(line).moved,
+      compute_line_shift(reverse_line(line)).moved};
+  for (unsigned j = 0; j < 4; ++j) {
+    if (j) toret.friction += rank_friction(line_rank(line, j - 1), line_rank(line, j));
+    if (line_rank(line, j) > toret.max_rank) toret.max_rank = line_rank(line, j);
+  }
+  return toret;
+}
+
+const LineTable<LineEval> line_eval_table = make_line_table(compute_line_eval);
+
+// a compact version of Board: every card is packed into a 4-bit "rank"
+// (0 => empty, 1 => 1, 2 => 2, 3 => 3, 4 => 6, ..., 14 => 6144, 15 => 12288)
+// so the whole grid fits in a single 64-bit word. cell (x, y) lives
+// at nibble x + y * BOARD_SIZE.
+class BitBoard {
+public:
+  typedef uint64_t cells_type;
+  typedef unsigned rank_type;
+
+  const static size_t BOARD_SIZE = Board::BOARD_SIZE;
+  const static size_t BOARD_ELTS = Board::BOARD_ELTS;
+  const static rank_type MAX_RANK = MAX_CARD_RANK;
+
+  struct ShiftResult {
+    cells_type cells;
+    bool moved;
+    unsigned merges;
+  };
+
+private:
+  cells_type cells;
+  NextColor nc;
+  Deck _deck;
+
+  static
+  size_t
+  _index(const CardPosition & pos) {
+    assert(Board::is_valid_card_position(pos));
+    return pos.x + pos.y * BOARD_SIZE;
+  }
+
+  rank_type
+  _rank(size_t idx) const {
+    return (cells >> (idx * 4)) & 0xf;
+  }
+
+  void
+  _set_rank(size_t idx, rank_type r) {
+    cells &= ~(cells_type(0xf) << (idx * 4));
+    cells |= cells_type(r) << (idx * 4);
+  }
+
+  static
+  line_type
+  _row(cells_type cells, size_t y) {
+    return cells >> (y * 16);
+  }
+
+  static
+  line_type
+  _column(cells_type cells, size_t x) {
+    auto c = (cells >> (x * 4)) & 0x000f000f000f000fULL;
+    return c | (c >> 12) | (c >> 24) | (c >> 36);
+  }
+
+  static
+  cells_type
+  _spread_column(line_type line) {
+    cells_type c = line;
+    return (c & 0xf) | ((c & 0xf0) << 12) | ((c & 0xf00) << 24) | ((c & 0xf000) << 36);
+  }
+
+public:
+  line_type
+  row(size_t y) const {
+    return _row(cells, y);
+  }
+
+  line_type
+  column(size_t x) const {
+    return _column(cells, x);
+  }
+
+  // one table lookup per line: rows for horizontal swipes, columns
+  // for vertical ones. lines are reversed when shifting towards
+  // their high end.
+  ShiftResult
+  shifted(const PlayerMove & pm) const {
+    ShiftResult toret = {0, false, 0};
+    for (size_t i = 0; i < BOARD_SIZE; ++i) {
+      switch (pm) {
+      case PlayerMove::SWIPE_LEFT: case PlayerMove::SWIPE_RIGHT: {
+        auto line = _row(cells, i);
+        auto reverse = pm == PlayerMove::SWIPE_RIGHT;
+        const auto & ls = line_shift_table[reverse ? reverse_line(line) : line];
+        toret.cells |= cells_type(reverse ? reverse_line(ls.line) : ls.line) << (i * 16);
+        toret.moved |= ls.moved;
+        toret.merges += ls.merges;
+        break;
+      }
+      case PlayerMove::SWIPE_UP: case PlayerMove::SWIPE_DOWN: {
+        auto line = _column(cells, i);
+        auto reverse = pm == PlayerMove::SWIPE_DOWN;
+        const auto & ls = line_shift_table[reverse ? reverse_line(line) : line];
+        toret.cells |= _spread_column(reverse ? reverse_line(ls.line) : ls.line) << (i * 4);
+        toret.moved |= ls.moved;
+        toret.merges += ls.merges;
+        break;
+      }
+      default: assert(false);
+      }
+    }
+    return toret;
+  }
+
+  static
+  rank_type
+  card_to_rank(const Card & card) {
+    auto value = card.value();
+    if (value < 3) return value;
+    auto rank = 3 + log_base_2(value / 3);
+    if (rank > MAX_RANK) throw std::runtime_error("card too big for BitBoard");
+    return rank;
+  }
+
+  static
+  Card
+  rank_to_card(rank_type rank) {
+    assert(rank <= MAX_RANK);
+    if (!rank) return nullcard;
+    if (rank < 3) return Card(rank);
+    return Card(3u << (rank - 3));
+  }
+
+  BitBoard(cells_type cells_, NextColor nc_, Deck deck_ = Deck::untracked())
+    : cells(cells_), nc(nc_), _deck(deck_) {}
+
+  explicit BitBoard(const Board & board) : cells(0), nc(board.next_color()), _deck(board.deck()) {
+    for (size_t y = 0; y < BOARD_SIZE; ++y) {
+      for (size_t x = 0; x < BOARD_SIZE; ++x) {
+        _set_rank(_index({x, y}), card_to_rank(board[{x, y}]));
+      }
+    }
+  }
+
+  Board
+  to_board() const {
+    std::vector<CardPlacement> placements;
+    for (size_t y = 0; y < BOARD_SIZE; ++y) {
+      for (size_t x = 0; x < BOARD_SIZE; ++x) {
+        auto card = (*this)[{x, y}];
+        if (card != nullcard) placements.push_back({card, {x, y}});
+      }
+    }
+    return Board(placements, nc, _deck);
+  }
+
+  // this board's next color and deck with other cells
+  BitBoard
+  with_cells(cells_type cells_) const {
+    return BitBoard(cells_, nc, _deck);
+  }
+
+  cells_type
+  raw_cells() const {
+    return cells;
+  }
+
+  NextColor
+  next_color() const {
+    return nc;
+  }
+
+  const Deck &
+  deck() const {
+    return _deck;
+  }
+
+  rank_type
+  rank(const CardPosition & pos) const {
+    return _rank(_index(pos));
+  }
+
+  Card
+  operator[](const CardPosition & pos) const {
+    return rank_to_card(rank(pos));
+  }
+
+  bool
+  can_shift(const PlayerMove & pm) const {
+    return shifted(pm).moved;
+  }
+
+  void
+  shift(const PlayerMove & pm) {
+    auto res = shifted(pm);
+    if (!res.moved) throw std::runtime_error("can't shift");
+    cells = res.cells;
+  }
+
+  void
+  computers_move(const PlayerMove & pm, const CardPlacement & cp, NextColor nc_) {
+    bool valid_for_swipe;
+    switch (pm) {
+    case PlayerMove::SWIPE_UP: valid_for_swipe = cp.position.y == BOARD_SIZE - 1; break;
+    case PlayerMove::SWIPE_DOWN: valid_for_swipe = cp.position.y == 0; break;
+    case PlayerMove::SWIPE_LEFT: valid_for_swipe = cp.position.x == BOARD_SIZE - 1; break;
+    case PlayerMove::SWIPE_RIGHT: valid_for_swipe = cp.position.x == 0; break;
+    default: assert(false); valid_for_swipe = false;
+    }
+
+    if (!valid_for_swipe ||
+        !Board::is_valid_card_position(cp.position) ||
+        rank(cp.position)) throw std::runtime_error("can't place card there");
+    _set_rank(_index(cp.position), card_to_rank(cp.card));
+    nc = nc_;
+    // only moves the search generates get here, which the deck can deal
+    _deck = _deck.placed(cp.card);
+  }
+
+  rank_type
+  max_rank() const {
+    rank_type toret = 0;
+    for (size_t y = 0; y < BOARD_SIZE; ++y) {
+      toret = std::max<rank_type>(toret, line_eval_table[row(y)].max_rank);
+    }
+    return toret;
+  }
+
+  Card
+  max_card() const {
+    return rank_to_card(max_rank());
+  }
+
+  bool
+  is_empty() const {
+    return !cells;
+  }
+
+  bool
+  operator==(const BitBoard & b) const {
+    return cells == b.cells && nc == b.nc && _deck == b._deck;
+  }
+
+  bool
+  operator!=(const BitBoard & b) const {
+    return !(*this == b);
+  }
+};
+
 // some printers for our custom types
 
 template <class Traits>
@@ -434,10 +916,14 @@ operator<<(std::basic_ostream<char,Traits> & os,
   return os << to_string(pm);
 }
 
-typedef double board_score_t;
+// the original floating point heuristic, kept around as the
+// reference for the integer one the search uses
+typedef double reference_score_t;
+
+#ifndef EMSCRIPTEN
 
 static
-board_score_t
+reference_score_t
 card_friction(const Card & a_, const Card & b_) {
   auto a = a_.value();
   auto b = b_.value();
@@ -483,9 +969,9 @@ card_friction(const Card & a_, const Card & b_) {
 }
 
 static
-board_score_t
+reference_score_t
 compute_board_friction(const Board & board) {
-  board_score_t board_friction = 0;
+  reference_score_t board_friction = 0;
 
   // first sum up the horizontal frictions
   for (unsigned x = 0; x < Board::BOARD_SIZE - 1; ++x) {
@@ -504,467 +990,4502 @@ compute_board_friction(const Board & board) {
   return board_friction;
 }
 
+#endif
+
+// the same friction as compute_board_friction(const Board &),
+// summed up a whole row or column at a time
 static
-board_score_t
-board_evaluator(const Board & board) {
-  return board.max_card().value() / compute_board_friction(board);
+unsigned
+compute_board_friction(const BitBoard & board) {
+  unsigned board_friction = 0;
+  for (size_t i = 0; i < Board::BOARD_SIZE; ++i) {
+    board_friction += line_eval_table[board.row(i)].friction;
+    board_friction += line_eval_table[board.column(i)].friction;
+  }
+  return board_friction;
 }
 
+#ifdef THREES_X86_SIMD
+
+// SIMD versions of compute_board_friction(const BitBoard &). the 16 ranks
+// get unpacked into bytes, then each byte is paired with its right
+// neighbor (shift by 1 byte) and its lower neighbor (shift by 4 bytes)
+// and rank_friction() is computed for all of those pairs at once.
+
+__attribute__((target("sse4.1")))
 static
-bool
-game_is_over(const Board & board) {
-  for (auto move : {
-         PlayerMove::SWIPE_UP,
-         PlayerMove::SWIPE_DOWN,
-         PlayerMove::SWIPE_LEFT,
-         PlayerMove::SWIPE_RIGHT}) {
-    if (board.can_shift(move)) return false;
-  }
+__m128i
+sse_unpack_ranks(BitBoard::cells_type cells) {
+  auto packed = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(&cells));
+  auto nibble_mask = _mm_set1_epi8(0xf);
+  auto low = _mm_and_si128(packed, nibble_mask);
+  auto high = _mm_and_si128(_mm_srli_epi16(packed, 4), nibble_mask);
+  return _mm_unpacklo_epi8(low, high);
+}
 
-  return true;
+// bytes in the rightmost column have no right neighbor
+#define THREES_SIMD_ROW_MASK                    \
+  -1, -1, -1, 0, -1, -1, -1, 0,                 \
+  -1, -1, -1, 0, -1, -1, -1, 0
+
+__attribute__((target("sse4.1")))
+static
+__m128i
+sse_rank_friction(__m128i a, __m128i b) {
+  auto zero = _mm_setzero_si128();
+  auto two = _mm_set1_epi8(2);
+  auto lo = _mm_min_epu8(a, b);
+  auto hi = _mm_max_epu8(a, b);
+
+  // 1 or 2 next to a 3-card counts as a 3 plus one
+  auto lo_is_small = _mm_cmpeq_epi8(_mm_min_epu8(lo, two), lo);
+  auto general = _mm_add_epi8(_mm_sub_epi8(hi, _mm_max_epu8(lo, _mm_set1_epi8(3))),
+                              _mm_and_si128(lo_is_small, _mm_set1_epi8(1)));
+
+  // 1s and 2s together: 2 if they're the same card, else 0
+  auto hi_is_small = _mm_cmpeq_epi8(_mm_min_epu8(hi, two), hi);
+  auto both_small = _mm_and_si128(_mm_cmpeq_epi8(a, b), two);
+  auto toret = _mm_blendv_epi8(general, both_small, hi_is_small);
+
+  // and nothing next to an empty cell
+  return _mm_andnot_si128(_mm_cmpeq_epi8(lo, zero), toret);
 }
 
+__attribute__((target("sse4.1")))
 static
-std::vector<CardPlacement>
-possible_computer_card_placements_post_shift(const Board & board, PlayerMove pm) {
-  std::vector<CardPlacement> toret;
+unsigned
+sse_board_friction(const BitBoard & board) {
+  auto ranks = sse_unpack_ranks(board.raw_cells());
+  auto right = _mm_and_si128(_mm_srli_si128(ranks, 1), _mm_setr_epi8(THREES_SIMD_ROW_MASK));
+  auto below = _mm_srli_si128(ranks, 4);
+  auto friction = _mm_add_epi8(sse_rank_friction(ranks, right),
+                               sse_rank_friction(ranks, below));
+  auto sums = _mm_sad_epu8(friction, _mm_setzero_si128());
+  return _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+}
 
-  CardPosition pos;
-  CardVector vector;
+// the horizontal pairs go in the low lane and the vertical pairs
+// in the high lane so every pair is done in one pass
+__attribute__((target("avx2")))
+static
+unsigned
+avx2_board_friction(const BitBoard & board) {
+  auto ranks = sse_unpack_ranks(board.raw_cells());
+  auto right = _mm_and_si128(_mm_srli_si128(ranks, 1), _mm_setr_epi8(THREES_SIMD_ROW_MASK));
+  auto below = _mm_srli_si128(ranks, 4);
+
+  auto a = _mm256_broadcastsi128_si256(ranks);
+  auto b = _mm256_inserti128_si256(_mm256_castsi128_si256(right), below, 1);
+
+  auto zero = _mm256_setzero_si256();
+  auto two = _mm256_set1_epi8(2);
+  auto lo = _mm256_min_epu8(a, b);
+  auto hi = _mm256_max_epu8(a, b);
+
+  auto lo_is_small = _mm256_cmpeq_epi8(_mm256_min_epu8(lo, two), lo);
+  auto general = _mm256_add_epi8(_mm256_sub_epi8(hi, _mm256_max_epu8(lo, _mm256_set1_epi8(3))),
+                                 _mm256_and_si256(lo_is_small, _mm256_set1_epi8(1)));
+  auto hi_is_small = _mm256_cmpeq_epi8(_mm256_min_epu8(hi, two), hi);
+  auto both_small = _mm256_and_si256(_mm256_cmpeq_epi8(a, b), two);
+  auto friction = _mm256_blendv_epi8(general, both_small, hi_is_small);
+  friction = _mm256_andnot_si256(_mm256_cmpeq_epi8(lo, zero), friction);
+
+  auto sums = _mm256_sad_epu8(friction, zero);
+  auto lanes = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+  return _mm_cvtsi128_si32(lanes) + _mm_extract_epi16(lanes, 4);
+}
 
-  switch (pm) {
-  case PlayerMove::SWIPE_UP: {
-    pos = {0, 3};
-    vector = {1, 0};
-    break;
-  }
-  case PlayerMove::SWIPE_DOWN: {
-    pos = {0, 0};
-    vector = {1, 0};
-    break;
-  }
-  case PlayerMove::SWIPE_LEFT: {
-    pos = {3, 0};
-    vector = {0, 1};
-    break;
-  }
-  case PlayerMove::SWIPE_RIGHT: {
-    pos = {0, 0};
-    vector = {0, 1};
-    break;
-  }
-  default: assert(false);
-  }
+#undef THREES_SIMD_ROW_MASK
 
-  for (size_t i = 0; i < Board::BOARD_SIZE; ++i, pos += vector) {
-    if (board[pos] != nullcard) continue;
+#endif
 
-    switch (board.next_color()) {
-    case NextColor::BLUE: toret.push_back({1, pos}); break;
-    case NextColor::RED: toret.push_back({2, pos}); break;
-    case NextColor::WHITE: {
-      toret.push_back({3, pos});
-      for (Card card = 6; card.value() < board.max_card().value(); card = card.combine(card)) {
-        toret.push_back({card, pos});
-      }
-      break;
-    }
-    default: assert(false);
-    }
-  }
+struct FrictionKernel {
+  const char *name;
+  unsigned (*friction)(const BitBoard &);
+};
 
+// every friction kernel this cpu can run, best first
+static
+std::vector<FrictionKernel>
+available_friction_kernels() {
+  std::vector<FrictionKernel> toret;
+#ifdef THREES_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) toret.push_back({"avx2", avx2_board_friction});
+  if (__builtin_cpu_supports("sse4.1")) toret.push_back({"sse4.1", sse_board_friction});
+#endif
+  toret.push_back({"table", compute_board_friction});
   return toret;
 }
 
-struct MinimaxResult {
-  PlayerMove best_move;
-  board_score_t move_score;
-  bool death_guaranteed;
-};
+static const FrictionKernel best_friction_kernel = available_friction_kernels().front();
 
-template <class F>
-MinimaxResult
-inner_alphabeta(F evaluator,
-                const Board & board,
-                unsigned depth,
-                board_score_t alpha, board_score_t beta) {
-  if (!depth) {
-    auto is_game_over = game_is_over(board);
-    return {PlayerMove::UNKNOWN, is_game_over ? std::numeric_limits<board_score_t>::lowest() : evaluator(board), is_game_over};
-  }
+#ifndef EMSCRIPTEN
 
-  // iterate over player's move
-  bool death_guaranteed = true;
-  PlayerMove best_move = PlayerMove::UNKNOWN;
-  for (auto move : {
+static
+reference_score_t
+board_evaluator(const Board & board) {
+  return board.max_card().value() / compute_board_friction(board);
+}
+
+#endif
+
+// scores are fixed-point max_card / friction. with at most 24 * 13 friction
+// on a board, 17 fractional bits keep every pair of distinct ratios
+// apart, so this orders boards exactly like board_evaluator() does.
+typedef int32_t board_score_t;
+
+const unsigned SCORE_FRACTION_BITS = 17;
+
+// everything a leaf of the search needs, gathered in one pass over
+// the rows and columns instead of a shift per direction for
+// game_is_over(), a pass for max_rank() and two for the friction
+struct LeafFeatures {
+  bool can_move;
+  BitBoard::rank_type max_rank;
+  unsigned friction;
+};
+
+static
+LeafFeatures
+leaf_features(const BitBoard & board) {
+  LeafFeatures toret = {false, 0, 0};
+  for (size_t i = 0; i < Board::BOARD_SIZE; ++i) {
+    const auto & row = line_eval_table[board.row(i)];
+    const auto & column = line_eval_table[board.column(i)];
+    toret.can_move |= row.moves_low | row.moves_high | column.moves_low | column.moves_high;
+    toret.max_rank = std::max<BitBoard::rank_type>(toret.max_rank, row.max_rank);
+    toret.friction += row.friction + column.friction;
+  }
+  return toret;
+}
+
+static
+bool
+same_features(const LeafFeatures & a, const LeafFeatures & b) {
+  return a.can_move == b.can_move && a.max_rank == b.max_rank && a.friction == b.friction;
+}
+
+// leaf_features() kept up to date as a board changes: only the rows
+// and columns whose cells changed are looked up again, which is one
+// of each after a placement and only the lines with a card that
+// moved after a swipe
+class BoardFeatures {
+  BitBoard::cells_type _cells;
+  LineEval _rows[Board::BOARD_SIZE];
+  LineEval _columns[Board::BOARD_SIZE];
+  unsigned _friction;
+  BitBoard::rank_type _max_rank;
+  // a bit per row and per column that can move either way
+  unsigned _moving_rows;
+  unsigned _moving_columns;
+
+  static
+  bool
+  moves(const LineEval & line) {
+    return line.moves_low || line.moves_high;
+  }
+
+  void
+  _totals() {
+    _friction = 0;
+    _max_rank = 0;
+    _moving_rows = _moving_columns = 0;
+    for (size_t i = 0; i < Board::BOARD_SIZE; ++i) {
+      _friction += _rows[i].friction + _columns[i].friction;
+      _max_rank = std::max<BitBoard::rank_type>(_max_rank, _rows[i].max_rank);
+      _moving_rows |= moves(_rows[i]) << i;
+      _moving_columns |= moves(_columns[i]) << i;
+    }
+  }
+
+public:
+  explicit BoardFeatures(const BitBoard & board) : _cells(board.raw_cells()) {
+    for (size_t i = 0; i < Board::BOARD_SIZE; ++i) {
+      _rows[i] = line_eval_table[board.row(i)];
+      _columns[i] = line_eval_table[board.column(i)];
+    }
+    _totals();
+  }
+
+  void
+  update(const BitBoard & board) {
+    auto changed = _cells ^ board.raw_cells();
+    for (size_t i = 0; i < Board::BOARD_SIZE; ++i) {
+      if ((changed >> (i * 16)) & 0xffff) _rows[i] = line_eval_table[board.row(i)];
+      if (changed & (0x000f000f000f000fULL << (i * 4))) _columns[i] = line_eval_table[board.column(i)];
+    }
+    _cells = board.raw_cells();
+    _totals();
+    assert(same_features(features(), leaf_features(board)));
+  }
+
+  LeafFeatures
+  features() const {
+    return {_moving_rows || _moving_columns, _max_rank, _friction};
+  }
+
+  // the features of `board`, which is this one with a card placed at
+  // `pos`, without updating anything: a placement only changes its
+  // row and column and never lowers the max rank
+  LeafFeatures
+  placed(const BitBoard & board, const CardPosition & pos) const {
+    assert(!((_cells ^ board.raw_cells()) & ~(BitBoard::cells_type(0xf) << ((pos.x + pos.y * 4) * 4))));
+    const auto & row = line_eval_table[board.row(pos.y)];
+    const auto & column = line_eval_table[board.column(pos.x)];
+    LeafFeatures toret = {
+      moves(row) || moves(column) ||
+      (_moving_rows & ~(1u << pos.y)) || (_moving_columns & ~(1u << pos.x)),
+      std::max<BitBoard::rank_type>(_max_rank, row.max_rank),
+      (_friction - _rows[pos.y].friction - _columns[pos.x].friction +
+       row.friction + column.friction),
+    };
+    assert(same_features(toret, leaf_features(board)));
+    return toret;
+  }
+};
+
+// evaluators score a BitBoard, and leaves through the features
+// leaf_features() already computed for them
+struct TableBoardEvaluator {
+  static
+  board_score_t
+  score(unsigned max_value, unsigned friction) {
+    // board_evaluator() divides by zero here
+    if (!friction) return max_value ? std::numeric_limits<board_score_t>::max() : 0;
+    return (max_value << SCORE_FRACTION_BITS) / friction;
+  }
+
+  board_score_t
+  operator()(const BitBoard & board) const {
+    return score(board.max_card().value(), best_friction_kernel.friction(board));
+  }
+
+  board_score_t
+  operator()(const LeafFeatures & features) const {
+    return score(BitBoard::rank_to_card(features.max_rank).value(), features.friction);
+  }
+
+  // the same scores for a whole batch of leaves, without branches so
+  // the loop vectorizes. the quotients are small enough that a double
+  // division floors to exactly the integer one
+  void
+  operator()(const LeafFeatures * features, size_t count, board_score_t * scores) const {
+    for (size_t i = 0; i < count; ++i) {
+      unsigned rank = features[i].max_rank;
+      unsigned max_value = rank < 3 ? rank : 3u << ((rank - 3) & 0xf);
+      unsigned friction = features[i].friction;
+      double numerator = double(max_value << SCORE_FRACTION_BITS);
+      board_score_t quotient = numerator / double(friction ? friction : 1);
+      scores[i] = (friction ? quotient :
+                   max_value ? std::numeric_limits<board_score_t>::max() : 0);
+    }
+  }
+};
+
+static const TableBoardEvaluator table_board_evaluator = {};
+
+template <class BoardType>
+static
+bool
+game_is_over(const BoardType & board) {
+  for (auto move : {
          PlayerMove::SWIPE_UP,
          PlayerMove::SWIPE_DOWN,
          PlayerMove::SWIPE_LEFT,
          PlayerMove::SWIPE_RIGHT}) {
-    if (!board.can_shift(move)) continue;
+    if (board.can_shift(move)) return false;
+  }
 
-    auto board2 = board;
-    board2.shift(move);
+  return true;
+}
 
-    // iterate over computer's move
-    auto computer_moved = false;
-    auto new_beta = beta;
-    for (const auto & cp : possible_computer_card_placements_post_shift(board2, move)) {
-      computer_moved = true;
+// at most 4 free cells on the edge, each with a 3 or any bonus card
+// up to 6144
+const size_t MAX_CARD_PLACEMENTS = 4 * (MAX_CARD_RANK - 3);
 
-      for (const auto & nc2 : {NextColor::RED, NextColor::BLUE, NextColor::WHITE}) {
-        // copy board & modify it
-        auto board3 = board2;
-        board3.computers_move(move, cp, nc2);
+// the computer's placements after a swipe. they live inline so that
+// the search never allocates for them
+class CardPlacements {
+  CardPlacement _placements[MAX_CARD_PLACEMENTS];
+  size_t _size = 0;
 
-        auto res = inner_alphabeta(evaluator, board3, depth - 1,
-                                   alpha, new_beta);
-        if (!res.death_guaranteed) death_guaranteed = false;
-        if (res.move_score < new_beta) {
-          new_beta = res.move_score;
-        }
+public:
+  void
+  push_back(const CardPlacement & placement) {
+    assert(_size < MAX_CARD_PLACEMENTS);
+    _placements[_size++] = placement;
+  }
 
-        if (new_beta <= alpha) break;
-      }
-    }
+  size_t
+  size() const {
+    return _size;
+  }
 
-    // the computer has no moves if and only if the player has no moves
-    assert(computer_moved);
+  bool
+  empty() const {
+    return !_size;
+  }
 
-    if (new_beta > alpha) {
-      best_move = move;
-      alpha = new_beta;
+  const CardPlacement &
+  operator[](size_t i) const {
+    assert(i < _size);
+    return _placements[i];
+  }
+
+  const CardPlacement *
+  begin() const {
+    return _placements;
+  }
+
+  const CardPlacement *
+  end() const {
+    return _placements + _size;
+  }
+};
+
+template <class BoardType>
+static
+CardPlacements
+possible_computer_card_placements_post_shift(const BoardType & board, PlayerMove pm) {
+  CardPlacements toret;
+
+  CardPosition pos;
+  CardVector vector;
+
+  switch (pm) {
+  case PlayerMove::SWIPE_UP: {
+    pos = {0, 3};
+    vector = {1, 0};
+    break;
+  }
+  case PlayerMove::SWIPE_DOWN: {
+    pos = {0, 0};
+    vector = {1, 0};
+    break;
+  }
+  case PlayerMove::SWIPE_LEFT: {
+    pos = {3, 0};
+    vector = {0, 1};
+    break;
+  }
+  case PlayerMove::SWIPE_RIGHT: {
+    pos = {0, 0};
+    vector = {0, 1};
+    break;
+  }
+  default: assert(false);
+  }
+
+  // a white card is a 3 or a bonus card. without a deck any card
+  // smaller than the max card is possible, with one only what the
+  // game actually deals
+  const auto & deck = board.deck();
+  auto max_value = board.max_card().value();
+  auto white_three = !deck.tracked() || deck.threes || !Deck::bonus_cards_possible(max_value);
+  auto max_bonus = (!deck.tracked() ? (max_value ? max_value - 1 : 0) :
+                    Deck::bonus_cards_possible(max_value) ? Deck::max_bonus_card(max_value) :
+                    0);
+
+  for (size_t i = 0; i < Board::BOARD_SIZE; ++i, pos += vector) {
+    if (board[pos] != nullcard) continue;
+
+    switch (board.next_color()) {
+    case NextColor::BLUE: toret.push_back({1, pos}); break;
+    case NextColor::RED: toret.push_back({2, pos}); break;
+    case NextColor::WHITE: {
+      if (white_three) toret.push_back({3, pos});
+      for (Card card = 6; card.value() <= max_bonus; card = card.combine(card)) {
+        toret.push_back({card, pos});
+      }
+      break;
     }
-    else if (best_move == PlayerMove::UNKNOWN) {
-      // this was still a valid move, it just
-      // wasn't any better than what we've already seen
-      // so no reason to update alpha
-      best_move = move;
+    default: assert(false);
     }
+  }
 
-    if (beta <= alpha) break;
+  return toret;
+}
+
+// the next colors the computer can show once it places `card` on
+// a board with `deck` and a max card of `max_value`, in RED, BLUE,
+// WHITE order. all three without a deck
+static
+size_t
+possible_next_colors(const Deck & deck, const Card & card, unsigned max_value,
+                     NextColor (&colors)[3]) {
+  auto after = deck.placed(card);
+  max_value = std::max(max_value, card.value());
+  size_t count = 0;
+  for (auto nc : {NextColor::RED, NextColor::BLUE, NextColor::WHITE}) {
+    if (after.can_show(nc, max_value)) colors[count++] = nc;
   }
+  return count;
+}
 
-  if (best_move == PlayerMove::UNKNOWN) {
-    // no move was available
-    return {PlayerMove::UNKNOWN, std::numeric_limits<board_score_t>::lowest(), true};
+struct MinimaxResult {
+  PlayerMove best_move;
+  board_score_t move_score;
+  bool death_guaranteed;
+};
+
+// zobrist hashing: every (cell, rank) pair and every next color gets a
+// random key and a board hashes to the xor of the keys it is made of.
+// the keys come from splitmix64 so they're fixed at compile time.
+
+typedef uint64_t zobrist_t;
+
+constexpr
+zobrist_t
+splitmix64(zobrist_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+struct ZobristKeys {
+  // rank 0 (an empty cell) hashes to 0
+  zobrist_t cells[BitBoard::BOARD_ELTS][MAX_CARD_RANK + 1];
+  zobrist_t colors[3];
+};
+
+constexpr
+ZobristKeys
+make_zobrist_keys() {
+  ZobristKeys keys{};
+  zobrist_t seed = 0;
+  for (size_t i = 0; i < BitBoard::BOARD_ELTS; ++i) {
+    for (unsigned rank = 1; rank <= MAX_CARD_RANK; ++rank) {
+      keys.cells[i][rank] = splitmix64(++seed);
+    }
   }
+  for (auto & key : keys.colors) key = splitmix64(++seed);
+  return keys;
+}
+
+constexpr ZobristKeys zobrist_keys = make_zobrist_keys();
 
-  return {best_move, alpha, death_guaranteed};
+static
+zobrist_t
+zobrist_color(NextColor nc) {
+  return zobrist_keys.colors[static_cast<size_t>(nc)];
 }
 
-template <class F>
+// rehashes only the cells that differ between `before` and `after`
+static
+zobrist_t
+zobrist_update_cells(zobrist_t hash,
+                     BitBoard::cells_type before,
+                     BitBoard::cells_type after) {
+  for (auto diff = before ^ after; diff; ) {
+    auto idx = __builtin_ctzll(diff) / 4;
+    hash ^= zobrist_keys.cells[idx][(before >> (idx * 4)) & 0xf];
+    hash ^= zobrist_keys.cells[idx][(after >> (idx * 4)) & 0xf];
+    diff &= ~(BitBoard::cells_type(0xf) << (idx * 4));
+  }
+  return hash;
+}
+
+// a tracked deck decides what can come next so it's part of the
+// position, an untracked one hashes to nothing
+static
+zobrist_t
+zobrist_deck(const Deck & deck) {
+  if (!deck.tracked()) return 0;
+  return splitmix64(0x6465636b00000000ULL | deck.ones | (deck.twos << 4) | (deck.threes << 8));
+}
+
+static
+zobrist_t
+zobrist_hash(const BitBoard & board) {
+  return zobrist_update_cells(zobrist_color(board.next_color()) ^ zobrist_deck(board.deck()),
+                              0, board.raw_cells());
+}
+
+// the 8 symmetries of the board. bit 0 mirrors it left to right,
+// bit 1 mirrors it top to bottom and bit 2 then transposes it. a
+// board and its transforms have the same score once the swipes are
+// transformed along with it
+typedef unsigned Transform;
+const Transform TRANSFORM_COUNT = 8;
+
+static
+BitBoard::cells_type
+mirror_cells_x(BitBoard::cells_type c) {
+  c = ((c & 0x0f0f0f0f0f0f0f0fULL) << 4) | ((c >> 4) & 0x0f0f0f0f0f0f0f0fULL);
+  return ((c & 0x00ff00ff00ff00ffULL) << 8) | ((c >> 8) & 0x00ff00ff00ff00ffULL);
+}
+
+static
+BitBoard::cells_type
+mirror_cells_y(BitBoard::cells_type c) {
+  c = ((c & 0x0000ffff0000ffffULL) << 16) | ((c >> 16) & 0x0000ffff0000ffffULL);
+  return (c << 32) | (c >> 32);
+}
+
+static
+BitBoard::cells_type
+transpose_cells(BitBoard::cells_type c) {
+  auto a = ((c & 0xf0f00f0ff0f00f0fULL) |
+            ((c & 0x0000f0f00000f0f0ULL) << 12) |
+            ((c & 0x0f0f00000f0f0000ULL) >> 12));
+  return ((a & 0xff00ff0000ff00ffULL) |
+          ((a & 0x00ff00ff00000000ULL) >> 24) |
+          ((a & 0x00000000ff00ff00ULL) << 24));
+}
+
+#ifndef EMSCRIPTEN
+
+static
+BitBoard::cells_type
+transform_cells(BitBoard::cells_type c, Transform t) {
+  if (t & 1) c = mirror_cells_x(c);
+  if (t & 2) c = mirror_cells_y(c);
+  if (t & 4) c = transpose_cells(c);
+  return c;
+}
+
+#endif
+
+// the swipe on the transformed board that does what `pm` does
+static
 PlayerMove
-run_minimax(F evaluator, const Board & board, unsigned level) {
-  // we run a basic alpha-beta minimax
-  // where the computer places the next card is considered it's move
-  auto ret = inner_alphabeta(evaluator, board, level,
-                             std::numeric_limits<board_score_t>::lowest(),
-                             std::numeric_limits<board_score_t>::max());
-  if (ret.death_guaranteed) {
-    std::cout << "Death is unavoidable at this point" << std::endl;
+transform_move(PlayerMove pm, Transform t) {
+  auto swap = [&] (PlayerMove a, PlayerMove b) {
+    pm = pm == a ? b : pm == b ? a : pm;
+  };
+  if (t & 1) swap(PlayerMove::SWIPE_LEFT, PlayerMove::SWIPE_RIGHT);
+  if (t & 2) swap(PlayerMove::SWIPE_UP, PlayerMove::SWIPE_DOWN);
+  if (t & 4) {
+    swap(PlayerMove::SWIPE_UP, PlayerMove::SWIPE_LEFT);
+    swap(PlayerMove::SWIPE_DOWN, PlayerMove::SWIPE_RIGHT);
   }
+  return pm;
+}
 
-  return ret.best_move;
+// transposing turns left to right mirroring into top to bottom
+static
+Transform
+inverse_transform(Transform t) {
+  return t & 4 ? (t & 4) | (t & 1) << 1 | (t & 2) >> 1 : t;
 }
 
-Board
-read_board_from_human_input(std::istream & is) {
-  // first read next color
-  std::string next_color_str;
-  is >> next_color_str;
-  if (!is) throw std::runtime_error("input valid");
-  auto next_color = human_string_to_next_color(next_color_str);
+struct CanonicalBoard {
+  // the smallest of the transformed boards
+  BitBoard::cells_type cells;
+  // takes the board to `cells`
+  Transform transform;
+  // bit t is set if transform t leaves the board as it is
+  unsigned symmetries;
+};
 
-  std::vector<CardPlacement> board_init;
-  for (unsigned j = 0; j < Board::BOARD_SIZE; ++j) {
-    for (unsigned i = 0; i < Board::BOARD_SIZE; ++i) {
-      unsigned card_value;
-      is >> card_value;
-      if (!is) throw std::runtime_error("invalid card!");
-      if (!card_value) continue;
-      Card c = card_value;
-      board_init.push_back({c, {i, j}});
+static
+CanonicalBoard
+canonicalize(BitBoard::cells_type c) {
+  BitBoard::cells_type transformed[TRANSFORM_COUNT];
+  transformed[0] = c;
+  transformed[1] = mirror_cells_x(c);
+  transformed[2] = mirror_cells_y(c);
+  transformed[3] = mirror_cells_y(transformed[1]);
+  for (Transform t = 0; t < 4; ++t) transformed[t | 4] = transpose_cells(transformed[t]);
+
+  CanonicalBoard toret = {c, 0, 0};
+  for (Transform t = 0; t < TRANSFORM_COUNT; ++t) {
+    if (transformed[t] < toret.cells) {
+      toret.cells = transformed[t];
+      toret.transform = t;
     }
+    if (transformed[t] == c) toret.symmetries |= 1u << t;
   }
+  return toret;
+}
 
-  return { board_init, next_color };
+// the table key of every transform of a board. splitmix64 is a
+// bijection so boards only collide through the next color
+static
+zobrist_t
+canonical_hash(const CanonicalBoard & canonical, NextColor nc, const Deck & deck) {
+  return splitmix64(canonical.cells) ^ zobrist_color(nc) ^ zobrist_deck(deck);
 }
 
-#ifdef EMSCRIPTEN
+enum class BoundType : uint8_t {
+  EXACT, LOWER, UPPER,
+};
 
-extern "C" {
+struct TranspositionEntry {
+  zobrist_t key;
+  board_score_t score;
+  // remaining depth of the search that produced this, 0 means unused
+  uint8_t depth;
+  BoundType bound;
+  PlayerMove best_move;
+  bool death_guaranteed;
+  // which search stored this, modulo 64
+  uint8_t generation;
+  // about how many nodes the search below this visited, log2
+  uint8_t log2_nodes;
+};
 
-void
-web_worker(char *data, size_t size) {
-  unsigned level;
-  std::memcpy(&level, data, sizeof(level));
-  auto is = std::istringstream(std::string(data + sizeof(level), data + size));
-  auto board = read_board_from_human_input(is);
-  auto player_move = run_minimax(board_evaluator, board, level);
-  char response_mut[sizeof(player_move)];
-  memcpy(response_mut, &player_move, sizeof(player_move));
-  emscripten_worker_respond(response_mut, sizeof(player_move));
-}
+// counted by each search rather than by the table so that
+// threads sharing a table don't fight over them
+struct TableStats {
+  unsigned long long probes = 0;
+  unsigned long long hits = 0;
+  unsigned long long cutoffs = 0;
+  unsigned long long stores = 0;
+  unsigned long long overwrites = 0;
+  // cutoffs from entries an earlier search stored and about how
+  // many nodes they saved, an overestimate for deeper entries
+  unsigned long long reused = 0;
+  unsigned long long reused_nodes = 0;
+
+  TableStats &
+  operator+=(const TableStats & b) {
+    probes += b.probes;
+    hits += b.hits;
+    cutoffs += b.cutoffs;
+    stores += b.stores;
+    overwrites += b.overwrites;
+    reused += b.reused;
+    reused_nodes += b.reused_nodes;
+    return *this;
+  }
 
-void *
-create_board(const char *textual_representation) {
-  try {
-    auto is = std::istringstream(textual_representation);
-    auto board = read_board_from_human_input(is);
-    return (void *) new Board(board);
+  void
+  print(std::ostream & out) const {
+    auto percent = [] (unsigned long long a, unsigned long long b) {
+      return b ? 100.0 * a / b : 0.0;
+    };
+    out << "tt: " << probes << " probes, "
+        << hits << " hits (" << std::fixed << std::setprecision(1)
+        << percent(hits, probes) << "%), "
+        << cutoffs << " cutoffs (" << percent(cutoffs, probes) << "%), "
+        << stores << " stores, "
+        << overwrites << " overwrites, "
+        << reused << " reused (~" << reused_nodes << " nodes saved)" << std::endl;
+    out.unsetf(std::ios_base::floatfield);
   }
-  catch (...) {
-    return nullptr;
+};
+
+// a fixed-size table of searched positions. each bucket has a slot that
+// keeps the deepest search and a slot that always takes the newest one.
+// entries only answer probes at the same remaining depth, so the
+// search returns the same scores with or without the table, unless
+// the search asks for deeper entries too.
+//
+// the table can be kept from one move to the next. every search starts
+// a new generation and the deepest slot goes to the current
+// generation before an older one, however deep.
+//
+// any number of threads can use the table at once without locking.
+// a slot is two 64-bit atomics, the entry packed into one and the key
+// xored with it in the other, so a slot torn by two threads storing
+// at once doesn't match any key and reads as empty.
+class TranspositionTable {
+  const static size_t BUCKET_SIZE = 2;
+
+  struct Slot {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;
+  };
+
+  std::unique_ptr<Slot[]> slots;
+  size_t bucket_mask;
+  unsigned _generation = 0;
+
+  Slot *
+  _bucket(zobrist_t key) const {
+    return &slots[(key & bucket_mask) * BUCKET_SIZE];
   }
-}
 
-size_t
-serialize_board(void *board, char *str, size_t size) {
-  auto board_p = (const Board *) board;
+  const static unsigned GENERATION_BITS = 6;
 
-  std::ostringstream serialized;
+  // score in the low 32 bits, then depth, bound, best move, death,
+  // generation and subtree size
+  static
+  uint64_t
+  _pack(const TranspositionEntry & entry) {
+    return (uint64_t(uint32_t(entry.score)) |
+            uint64_t(entry.depth) << 32 |
+            uint64_t(entry.bound) << 40 |
+            uint64_t(entry.best_move) << 42 |
+            uint64_t(entry.death_guaranteed) << 45 |
+            uint64_t(entry.generation) << 46 |
+            uint64_t(entry.log2_nodes) << 52);
+  }
+
+  static
+  TranspositionEntry
+  _unpack(zobrist_t key, uint64_t data) {
+    return {key, board_score_t(uint32_t(data)), uint8_t(data >> 32),
+        BoundType((data >> 40) & 3), PlayerMove((data >> 42) & 7), bool((data >> 45) & 1),
+        uint8_t((data >> 46) & 0x3f), uint8_t((data >> 52) & 0x3f)};
+  }
+
+public:
+  // 32 GiB, already more than anything we'd run on
+  const static unsigned MAX_LOG2_BUCKETS = 30;
+
+  explicit TranspositionTable(unsigned log2_buckets)
+    : slots(new Slot[BUCKET_SIZE << log2_buckets]),
+      bucket_mask((size_t(1) << log2_buckets) - 1) {
+    clear();
+  }
+
+  unsigned
+  generation() const {
+    return _generation;
+  }
+
+  // call before each search that keeps what earlier ones stored,
+  // not safe while other threads are using the table
+  void
+  next_generation() {
+    _generation = (_generation + 1) % (1u << GENERATION_BITS);
+  }
+
+  // not safe while other threads are using the table
+  void
+  clear() {
+    for (size_t i = 0; i < (bucket_mask + 1) * BUCKET_SIZE; ++i) {
+      slots[i].check.store(0, std::memory_order_relaxed);
+      slots[i].data.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // fills `entry` with the entry for `key` at any depth, callers check
+  // the depth before trusting the score but can always use the best move
+  bool
+  probe(zobrist_t key, TranspositionEntry & entry) const {
+    auto bucket = _bucket(key);
+    for (size_t i = 0; i < BUCKET_SIZE; ++i) {
+      auto data = bucket[i].data.load(std::memory_order_relaxed);
+      auto check = bucket[i].check.load(std::memory_order_relaxed);
+      // an unused slot has a depth of 0
+      if ((data >> 32 & 0xff) && (check ^ data) == key) {
+        entry = _unpack(key, data);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // `nodes` is how many nodes the search of this position visited.
+  // returns true if this replaced another position
+  bool
+  store(zobrist_t key, unsigned depth, BoundType bound,
+        const MinimaxResult & res, unsigned long long nodes) {
+    assert(depth && depth <= std::numeric_limits<uint8_t>::max());
+
+    auto bucket = _bucket(key);
+    auto key_of = [] (const Slot & slot) {
+      return slot.check.load(std::memory_order_relaxed) ^ slot.data.load(std::memory_order_relaxed);
+    };
+    auto depth_of = [] (const Slot & slot) {
+      return unsigned(slot.data.load(std::memory_order_relaxed) >> 32 & 0xff);
+    };
+    auto generation_of = [] (const Slot & slot) {
+      return unsigned(slot.data.load(std::memory_order_relaxed) >> 46 & 0x3f);
+    };
+
+    auto & deepest = bucket[0];
+    auto & newest = bucket[1];
+    auto & slot = (key_of(deepest) == key || depth >= depth_of(deepest) ||
+                   generation_of(deepest) != _generation) ? deepest : newest;
+    auto overwrite = depth_of(slot) && key_of(slot) != key;
+
+    uint8_t log2_nodes = nodes ? 63 - __builtin_clzll(nodes) : 0;
+
+    auto data = _pack({key, res.move_score, uint8_t(depth), bound, res.best_move, res.death_guaranteed,
+          uint8_t(_generation), log2_nodes});
+    slot.data.store(data, std::memory_order_relaxed);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+    return overwrite;
+  }
+};
+
+const unsigned MAX_SEARCH_DEPTH = 64;
+
+class SearchAborted : public std::exception {};
+
+#ifdef THREES_SEARCH_STATS
+
+// where one search's time went, written out by --search-stats. only
+// built with THREES_SEARCH_STATS, SEARCH_STATS() throws away what's
+// inside it otherwise so the search doesn't pay for any of it
+struct SearchStats {
+  // by plies left, 0 being the leaves
+  unsigned long long nodes[MAX_SEARCH_DEPTH + 1];
+  // player's nodes that weren't answered by the table, and those
+  // of them where a swipe beat beta so the rest were skipped
+  unsigned long long expanded;
+  unsigned long long beta_cutoffs;
+  // swipes searched and those the computer refuted, and how many
+  // of those its first reply already refuted
+  unsigned long long swipes;
+  unsigned long long refutations;
+  unsigned long long first_reply_refutations;
+  // every iteration of iterative deepening by depth, or the
+  // one search of a fixed depth search
+  double iteration_ms[MAX_SEARCH_DEPTH + 1];
+  unsigned long long iteration_nodes[MAX_SEARCH_DEPTH + 1];
+
+  SearchStats &
+  operator+=(const SearchStats & b) {
+    for (size_t i = 0; i <= MAX_SEARCH_DEPTH; ++i) nodes[i] += b.nodes[i];
+    expanded += b.expanded;
+    beta_cutoffs += b.beta_cutoffs;
+    swipes += b.swipes;
+    refutations += b.refutations;
+    first_reply_refutations += b.first_reply_refutations;
+    return *this;
+  }
+};
+
+#define SEARCH_STATS(...) __VA_ARGS__
+
+// cycles, instructions and cache misses of the calling thread from
+// perf_event_open(). the kernel doesn't always allow it, then
+// valid() is false and nothing is counted
+class PerfCounters {
+  int _fds[3] = {-1, -1, -1};
+
+public:
+  PerfCounters() {
+#ifdef __linux__
+    const uint64_t configs[] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+    };
+    for (size_t i = 0; i < 3; ++i) {
+      perf_event_attr attr = {};
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      // one group so they're all counted over the same time
+      _fds[i] = int(syscall(__NR_perf_event_open, &attr, 0, -1, i ? _fds[0] : -1, 0));
+      if (_fds[i] < 0) {
+        _close();
+        return;
+      }
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters & operator=(const PerfCounters &) = delete;
+
+  ~PerfCounters() {
+    _close();
+  }
+
+  bool
+  valid() const {
+    return _fds[0] >= 0;
+  }
+
+  void
+  start() {
+#ifdef __linux__
+    if (!valid()) return;
+    ioctl(_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  }
+
+  // cycles, instructions and cache misses since start()
+  bool
+  stop(uint64_t (&counts)[3]) {
+#ifdef __linux__
+    if (!valid()) return false;
+    ioctl(_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for (size_t i = 0; i < 3; ++i) {
+      if (read(_fds[i], &counts[i], sizeof(counts[i])) != sizeof(counts[i])) return false;
+    }
+    return true;
+#else
+    (void) counts;
+    return false;
+#endif
+  }
+
+private:
+  void
+  _close() {
+#ifdef __linux__
+    for (auto & fd : _fds) {
+      if (fd >= 0) close(fd);
+      fd = -1;
+    }
+#endif
+  }
+};
+
+#else
+
+#define SEARCH_STATS(...)
+
+#endif
+
+enum class MoveOrdering {
+  // swipes in UP, DOWN, LEFT, RIGHT order and placements
+  // in the order they are generated
+  FIXED,
+  // hash move, static scores, history and killers
+  HEURISTIC,
+};
+
+// how the root and the player's nodes use the alpha-beta window
+enum class SearchDriver {
+  // every swipe gets the whole window
+  ALPHABETA,
+  // principal variation search: swipes after the first are scouted
+  // with a null window and only searched with the whole window when
+  // the scout says they might be better
+  PVS,
+  // the root closes in on the score with null window searches only,
+  // see Plaat et al. "Best-first fixed-depth minimax algorithms"
+  MTDF,
+};
+
+struct ComputerMove {
+  CardPlacement placement;
+  NextColor next_color;
+
+  bool
+  operator==(const ComputerMove & b) const {
+    return (placement.card == b.placement.card &&
+            placement.position.x == b.placement.position.x &&
+            placement.position.y == b.placement.position.y &&
+            next_color == b.next_color);
+  }
+};
+
+// how far the player's search may stray from a full width search.
+// everything is off by default
+struct Selectivity {
+  // late-move reductions: at depth lmr_depth and up, the swipes
+  // ordered after the first lmr_moves are searched lmr_reduction
+  // plies shallower, and again at full depth if they beat alpha
+  unsigned lmr_depth = 0;
+  unsigned lmr_moves = 1;
+  unsigned lmr_reduction = 1;
+  // futility pruning: at depth futility_depth and below, a swipe is
+  // skipped when its static score plus futility_margin percent of
+  // it per ply left can't beat alpha. the computer's cards only ever
+  // add friction so the static score is already optimistic, and the
+  // margin may well be negative
+  unsigned futility_depth = 0;
+  int futility_margin = 0;
+};
+
+// per-search state shared by every node of one search
+struct SearchContext {
+  typedef std::chrono::steady_clock clock;
+
+  // may be null to search without a transposition table
+  TranspositionTable *tt;
+  TableStats tt_stats = {};
+  // every node visited, leaves included
+  unsigned long long nodes = 0;
+  // leaves that weren't visited because they only differ from one
+  // that was in the next color, which a leaf's score doesn't depend on
+  unsigned long long collapsed_leaves = 0;
+  SEARCH_STATS(SearchStats stats = {};)
+
+  MoveOrdering ordering = MoveOrdering::HEURISTIC;
+  SearchDriver driver = SearchDriver::ALPHABETA;
+  // key the table on the canonical board and merge swipes that
+  // a symmetry of the board makes equivalent
+  bool symmetry = true;
+  // let entries from deeper searches answer probes too. scores are
+  // no longer the same as without the table, but a table kept from
+  // the last move can then answer for this one, which searches
+  // everything a ply deeper than it did
+  bool deeper_cutoffs = false;
+  // evaluate the children of a node one ply above the leaves all at
+  // once through the evaluator's batch overload
+  bool batch_leaves = true;
+  Selectivity selectivity = {};
+  // how often each swipe was the best move, weighted by depth
+  unsigned long long history[4] = {};
+  // the last two computer's moves that refuted a swipe at each depth
+  ComputerMove killers[MAX_SEARCH_DEPTH + 1][2] = {};
+
+  // when abortable the search throws SearchAborted once
+  // it's past the deadline, has visited node_limit nodes
+  // or another thread sets stop
+  bool abortable = false;
+  clock::time_point deadline = clock::time_point::max();
+  unsigned long long node_limit = std::numeric_limits<unsigned long long>::max();
+  const std::atomic<bool> *stop = nullptr;
+
+  static
+  size_t
+  move_index(PlayerMove pm) {
+    assert(pm != PlayerMove::UNKNOWN);
+    return static_cast<size_t>(pm) - 1;
+  }
+
+  void
+  add_killer(unsigned depth, const ComputerMove & cm) {
+    auto & k = killers[depth];
+    if (k[0] == cm) return;
+    k[1] = k[0];
+    k[0] = cm;
+  }
+
+  bool
+  is_killer(unsigned depth, const ComputerMove & cm) const {
+    return killers[depth][0] == cm || killers[depth][1] == cm;
+  }
+
+  void
+  visit() {
+    ++nodes;
+    if (!abortable) return;
+    // looking at the clock is slow, only do it every so often
+    if (nodes >= node_limit ||
+        (!(nodes % 1024) && (clock::now() >= deadline || (stop && *stop)))) {
+      throw SearchAborted();
+    }
+  }
+};
+
+// std::stable_sort allocates a buffer, this doesn't. the search only
+// sorts a few swipes or placements at a time
+template <class T, class Compare>
+static
+void
+insertion_sort(T *first, T *last, Compare less) {
+  if (first == last) return;
+  for (auto i = first + 1; i != last; ++i) {
+    auto value = *i;
+    auto j = i;
+    for (; j != first && less(value, *(j - 1)); --j) *j = *(j - 1);
+    *j = value;
+  }
+}
+
+struct Swipe {
+  PlayerMove move;
+  BitBoard::cells_type cells;
+  board_score_t static_score;
+};
+
+// fills `swipes` with the legal swipes in the order they should be
+// searched and returns how many there are
+template <class F>
+size_t
+order_swipes(F evaluator, const SearchContext & ctx,
+             const BitBoard & board, PlayerMove hash_move, unsigned depth,
+             Swipe (&swipes)[4]) {
+  size_t count = 0;
+  for (auto move : {
+         PlayerMove::SWIPE_UP,
+         PlayerMove::SWIPE_DOWN,
+         PlayerMove::SWIPE_LEFT,
+         PlayerMove::SWIPE_RIGHT}) {
+    auto res = board.shifted(move);
+    if (res.moved) swipes[count++] = {move, res.cells, 0};
+  }
+
+  if (ctx.ordering == MoveOrdering::FIXED || count < 2) return count;
+
+  // just above the leaves evaluating every swipe costs more than the
+  // better order saves, history alone is good enough there
+  if (depth > 1) {
+    for (size_t i = 0; i < count; ++i) {
+      swipes[i].static_score = evaluator(board.with_cells(swipes[i].cells));
+    }
+  }
+
+  insertion_sort(swipes, swipes + count, [&] (const Swipe & a, const Swipe & b) {
+      if ((a.move == hash_move) != (b.move == hash_move)) return a.move == hash_move;
+      auto a_history = ctx.history[SearchContext::move_index(a.move)];
+      auto b_history = ctx.history[SearchContext::move_index(b.move)];
+      if (a_history != b_history) return a_history > b_history;
+      return a.static_score > b.static_score;
+    });
+
+  return count;
+}
+
+// drops the swipes that a symmetry of the board turns into a swipe
+// earlier in UP, DOWN, LEFT, RIGHT order. they score the same so
+// they would lose the tie anyway
+static
+size_t
+merge_symmetric_swipes(Swipe (&swipes)[4], size_t count, unsigned symmetries) {
+  if (symmetries == 1) return count;
+
+  size_t kept = 0;
+  for (size_t i = 0; i < count; ++i) {
+    bool redundant = false;
+    for (Transform t = 1; t < TRANSFORM_COUNT; ++t) {
+      if ((symmetries >> t & 1) && transform_move(swipes[i].move, t) < swipes[i].move) {
+        redundant = true;
+      }
+    }
+    if (!redundant) swipes[kept++] = swipes[i];
+  }
+  return kept;
+}
+
+// and any of the placements with each next color
+const size_t MAX_COMPUTER_MOVES = MAX_CARD_PLACEMENTS * 3;
+
+// fills `order` with the indices of `placements` in the order they
+// should be searched
+template <class F>
+void
+order_placements(F evaluator, const SearchContext & ctx,
+                 const BitBoard & board, PlayerMove move, unsigned depth,
+                 const CardPlacements & placements,
+                 size_t (&order)[MAX_CARD_PLACEMENTS]) {
+  for (size_t i = 0; i < placements.size(); ++i) order[i] = i;
+
+  // at depth 1 the children are leaves so this would just evaluate
+  // them twice
+  if (ctx.ordering == MoveOrdering::FIXED || depth <= 1) return;
+
+  // try the placements that look worst for the player first, the
+  // next color doesn't change the static score
+  board_score_t scores[MAX_CARD_PLACEMENTS];
+  for (size_t i = 0; i < placements.size(); ++i) {
+    auto board2 = board;
+    board2.computers_move(move, placements[i], board.next_color());
+    scores[i] = evaluator(board2);
+  }
+  insertion_sort(order, order + placements.size(), [&] (size_t a, size_t b) {
+      return scores[a] < scores[b];
+    });
+}
+
+static
+bool
+same_placement(const CardPlacement & a, const CardPlacement & b) {
+  return (a.card == b.card &&
+          a.position.x == b.position.x &&
+          a.position.y == b.position.y);
+}
+
+template <class F>
+MinimaxResult
+inner_alphabeta(F evaluator,
+                SearchContext & ctx,
+                const BitBoard & board,
+                zobrist_t hash,
+                unsigned depth,
+                board_score_t alpha, board_score_t beta) {
+  ctx.visit();
+  SEARCH_STATS(++ctx.stats.nodes[depth];)
+
+  if (!depth) {
+    auto features = leaf_features(board);
+    if (!features.can_move) return {PlayerMove::UNKNOWN, std::numeric_limits<board_score_t>::lowest(), true};
+    return {PlayerMove::UNKNOWN, evaluator(features), false};
+  }
+
+  // with symmetry the table is keyed on the canonical board and
+  // its best moves are the ones for the canonical board
+  CanonicalBoard canonical = {board.raw_cells(), 0, 1};
+  if (ctx.symmetry) {
+    canonical = canonicalize(board.raw_cells());
+    hash = canonical_hash(canonical, board.next_color(), board.deck());
+  }
+  auto from_canonical = inverse_transform(canonical.transform);
+
+  assert(!ctx.tt || ctx.symmetry || hash == zobrist_hash(board));
+
+  auto original_alpha = alpha;
+  auto nodes_before = ctx.nodes;
+  auto hash_move = PlayerMove::UNKNOWN;
+  TranspositionEntry entry;
+  if (ctx.tt && (++ctx.tt_stats.probes, ctx.tt->probe(hash, entry))) {
+    ++ctx.tt_stats.hits;
+    hash_move = transform_move(entry.best_move, from_canonical);
+    if ((entry.depth == depth || (ctx.deeper_cutoffs && entry.depth > depth)) &&
+        (entry.bound == BoundType::EXACT ||
+         (entry.bound == BoundType::LOWER && entry.score >= beta) ||
+         (entry.bound == BoundType::UPPER && entry.score <= alpha))) {
+      ++ctx.tt_stats.cutoffs;
+      if (entry.generation != ctx.tt->generation()) {
+        ++ctx.tt_stats.reused;
+        ctx.tt_stats.reused_nodes += 1ULL << entry.log2_nodes;
+      }
+      return {hash_move, entry.score, entry.death_guaranteed};
+    }
+  }
+
+  Swipe swipes[4];
+  auto swipe_count = order_swipes(evaluator, ctx, board, hash_move, depth, swipes);
+  swipe_count = merge_symmetric_swipes(swipes, swipe_count, canonical.symmetries);
+  SEARCH_STATS(++ctx.stats.expanded;)
+
+  // iterate over player's move. scores outside the window are still
+  // bounds on the real score, which MTD(f) needs to close in quickly
+  bool death_guaranteed = true;
+  PlayerMove best_move = PlayerMove::UNKNOWN;
+  auto best_score = std::numeric_limits<board_score_t>::lowest();
+  for (size_t i = 0; i < swipe_count; ++i) {
+    auto move = swipes[i].move;
+    auto board2 = board.with_cells(swipes[i].cells);
+
+    // ties go to the move that comes first in UP, DOWN, LEFT, RIGHT
+    // order no matter what order they're searched in, so a move that
+    // would win a tie gets a window one lower to tell ties apart
+    auto wins_ties = best_move == PlayerMove::UNKNOWN || move < best_move;
+    auto search_alpha = (wins_ties && best_move != PlayerMove::UNKNOWN &&
+                         alpha > std::numeric_limits<board_score_t>::lowest()
+                         ? alpha - 1 : alpha);
+
+    // only once a searched swipe is known to survive, so that
+    // skipping or reducing the rest can't change death_guaranteed
+    const auto & sel = ctx.selectivity;
+    auto selective = i > 0 && !death_guaranteed;
+    if (selective && depth <= sel.futility_depth) {
+      std::int64_t score = evaluator(board2);
+      if (score + score * sel.futility_margin * depth / 100 <= search_alpha) {
+        best_score = std::max(best_score, alpha);
+        continue;
+      }
+    }
+    // the reduced search still has to leave a ply for the computer
+    auto reduction = (selective && sel.lmr_depth && depth >= sel.lmr_depth &&
+                      i >= sel.lmr_moves && depth > 2
+                      ? std::min(sel.lmr_reduction, depth - 2) : 0);
+
+    // leaves don't look at the table so don't bother hashing them
+    auto hash_children = ctx.tt && depth > 1 && !ctx.symmetry;
+    auto hash2 = hash_children ? zobrist_update_cells(hash, board.raw_cells(), board2.raw_cells()) : 0;
+
+    // iterate over computer's move
+    auto placements = possible_computer_card_placements_post_shift(board2, move);
+
+    // the computer has no moves if and only if the player has no moves
+    assert(!placements.empty());
+
+    size_t order[MAX_CARD_PLACEMENTS];
+    order_placements(evaluator, ctx, board2, move, depth, placements, order);
+
+    // killers that are legal here get searched before everything else,
+    // copied since searching can replace them. every move also
+    // remembers which placement it is
+    ComputerMove computer_moves[MAX_COMPUTER_MOVES];
+    size_t placement_of[MAX_COMPUTER_MOVES];
+    size_t killer_count = 0;
+    const auto & deck = board2.deck();
+    auto max_value = deck.tracked() ? board2.max_card().value() : 0;
+    if (ctx.ordering == MoveOrdering::HEURISTIC) {
+      for (const auto & killer : ctx.killers[depth]) {
+        auto it = std::find_if(placements.begin(), placements.end(), [&] (const CardPlacement & p) {
+            return same_placement(p, killer.placement);
+          });
+        if (it != placements.end() &&
+            deck.placed(killer.placement.card).can_show(
+              killer.next_color, std::max(max_value, killer.placement.card.value()))) {
+          placement_of[killer_count] = it - placements.begin();
+          computer_moves[killer_count++] = killer;
+        }
+      }
+    }
+    auto computer_move_count = killer_count;
+    for (size_t j = 0; j < placements.size(); ++j) {
+      NextColor colors[3];
+      auto color_count = possible_next_colors(deck, placements[order[j]].card, max_value, colors);
+      for (size_t c = 0; c < color_count; ++c) {
+        auto nc = colors[c];
+        ComputerMove cm = {placements[order[j]], nc};
+        if (std::find(computer_moves, computer_moves + killer_count, cm) !=
+            computer_moves + killer_count) continue;
+        placement_of[computer_move_count] = order[j];
+        computer_moves[computer_move_count++] = cm;
+      }
+    }
+
+    // new_beta is the window for the replies left and
+    // swipe_score the lowest reply so far
+    auto new_beta = beta;
+    auto swipe_score = std::numeric_limits<board_score_t>::max();
+    SEARCH_STATS(++ctx.stats.swipes; size_t replies_scored = 0;)
+    // returns true if the computer found a refutation
+    auto computers_move_scored = [&] (const ComputerMove & cm, const MinimaxResult & res) {
+      SEARCH_STATS(++replies_scored;)
+      if (!res.death_guaranteed) death_guaranteed = false;
+      swipe_score = std::min(swipe_score, res.move_score);
+      if (res.move_score < new_beta) {
+        new_beta = res.move_score;
+      }
+
+      if (new_beta <= search_alpha) {
+        ctx.add_killer(depth, cm);
+        SEARCH_STATS(++ctx.stats.refutations;
+                     if (replies_scored == 1) ++ctx.stats.first_reply_refutations;)
+        return true;
+      }
+      return false;
+    };
+
+    // a leaf's score doesn't depend on the next color, so the last
+    // ply has one leaf per placement rather than three
+    if (depth == 1 && ctx.batch_leaves) {
+      // every leaf is evaluated up front and the cutoffs are then
+      // taken in the same order as searching them one by one would
+      LeafFeatures features[MAX_CARD_PLACEMENTS];
+      board_score_t scores[MAX_CARD_PLACEMENTS];
+      // each leaf is a placement away from board2 so only
+      // its row and column need looking up
+      const BoardFeatures board2_features(board2);
+      for (size_t j = 0; j < placements.size(); ++j) {
+        ctx.visit();
+        SEARCH_STATS(++ctx.stats.nodes[0];)
+        auto board3 = board2;
+        board3.computers_move(move, placements[j], board2.next_color());
+        features[j] = board2_features.placed(board3, placements[j].position);
+      }
+      evaluator(features, placements.size(), scores);
+      ctx.collapsed_leaves += computer_move_count - placements.size();
+
+      for (size_t j = 0; j < computer_move_count; ++j) {
+        auto p = placement_of[j];
+        MinimaxResult res = (features[p].can_move
+                             ? MinimaxResult{PlayerMove::UNKNOWN, scores[p], false}
+                             : MinimaxResult{PlayerMove::UNKNOWN,
+                                 std::numeric_limits<board_score_t>::lowest(), true});
+        if (computers_move_scored(computer_moves[j], res)) break;
+      }
+    }
+    else {
+      MinimaxResult leaves[MAX_CARD_PLACEMENTS];
+      bool searched_leaf[MAX_CARD_PLACEMENTS] = {};
+      auto search_replies = [&] (unsigned child_depth, board_score_t window) {
+        new_beta = window;
+        swipe_score = std::numeric_limits<board_score_t>::max();
+        for (size_t j = 0; j < computer_move_count; ++j) {
+          const auto & cm = computer_moves[j];
+          auto p = placement_of[j];
+          if (child_depth == 0 && searched_leaf[p]) {
+            ++ctx.collapsed_leaves;
+            if (computers_move_scored(cm, leaves[p])) break;
+            continue;
+          }
+
+          // copy board & modify it
+          auto board3 = board2;
+          board3.computers_move(move, cm.placement, cm.next_color);
+
+          auto hash3 = hash_children
+            ? (zobrist_update_cells(hash2, board2.raw_cells(), board3.raw_cells()) ^
+               zobrist_color(board2.next_color()) ^ zobrist_color(cm.next_color) ^
+               zobrist_deck(board2.deck()) ^ zobrist_deck(board3.deck()))
+            : 0;
+
+          auto res = inner_alphabeta(evaluator, ctx, board3, hash3, child_depth,
+                                     search_alpha, new_beta);
+          if (child_depth == 0) {
+            leaves[p] = res;
+            searched_leaf[p] = true;
+          }
+          if (computers_move_scored(cm, res)) break;
+        }
+      };
+
+      // a scout that fails high is a lower bound good enough for a
+      // cutoff, unless it was also reduced
+      auto scout = (ctx.driver == SearchDriver::PVS && best_move != PlayerMove::UNKNOWN &&
+                    search_alpha + 1 < beta);
+      search_replies(depth - 1 - reduction, scout ? search_alpha + 1 : beta);
+      if ((reduction || scout) && swipe_score > search_alpha && (reduction || swipe_score < beta)) {
+        search_replies(depth - 1, beta);
+      }
+    }
+
+    auto previous_best = best_score;
+    best_score = std::max(best_score, swipe_score);
+    if (swipe_score > alpha) {
+      best_move = move;
+      alpha = swipe_score;
+      ctx.history[SearchContext::move_index(move)] += depth * depth;
+    }
+    else if (wins_ties && (swipe_score == alpha || best_move == PlayerMove::UNKNOWN)) {
+      // this was still a valid move, it just
+      // wasn't any better than what we've already seen
+      // so no reason to update alpha
+      best_move = move;
+    }
+    else if (alpha == original_alpha &&
+             (swipe_score > previous_best || (wins_ties && swipe_score == previous_best))) {
+      // nothing is inside the window yet, the best bound is the best
+      // guess. a lost position has nothing below it, so its move is
+      // the same as with any other window
+      best_move = move;
+    }
+
+    if (beta <= alpha) {
+      SEARCH_STATS(++ctx.stats.beta_cutoffs;)
+      break;
+    }
+  }
+
+  if (best_move == PlayerMove::UNKNOWN) {
+    // no move was available
+    return {PlayerMove::UNKNOWN, std::numeric_limits<board_score_t>::lowest(), true};
+  }
+
+  MinimaxResult toret = {best_move, best_score, death_guaranteed};
+  if (ctx.tt) {
+    auto bound = (best_score <= original_alpha ? BoundType::UPPER :
+                  best_score >= beta ? BoundType::LOWER :
+                  BoundType::EXACT);
+    auto canonical_res = toret;
+    canonical_res.best_move = transform_move(best_move, canonical.transform);
+    ++ctx.tt_stats.stores;
+    if (ctx.tt->store(hash, depth, bound, canonical_res, ctx.nodes - nodes_before)) {
+      ++ctx.tt_stats.overwrites;
+    }
+  }
+
+  return toret;
+}
+
+template <class F>
+PlayerMove
+run_minimax(F evaluator, SearchContext & ctx, const Board & board, unsigned level) {
+  // we run a basic alpha-beta minimax
+  // where the computer places the next card is considered it's move
+  BitBoard root(board);
+  auto ret = inner_alphabeta(evaluator, ctx, root, zobrist_hash(root),
+                             std::min(level, MAX_SEARCH_DEPTH),
+                             std::numeric_limits<board_score_t>::lowest(),
+                             std::numeric_limits<board_score_t>::max());
+  if (ret.death_guaranteed) {
+    std::cout << "Death is unavoidable at this point" << std::endl;
+  }
+
+  return ret.best_move;
+}
+
+template <class F>
+PlayerMove
+run_minimax(F evaluator, const Board & board, unsigned level) {
+  SearchContext ctx = {nullptr};
+  return run_minimax(evaluator, ctx, board, level);
+}
+
+// the expectimax engine treats the computer's moves as random
+// instead of adversarial
+enum class SearchEngine {
+  MINIMAX,
+  EXPECTIMAX,
+};
+
+// how expectimax cuts off chance nodes, see Ballard's "The *-minimax
+// search procedure for trees containing chance nodes"
+enum class ChancePruning {
+  NONE,
+  // stop a chance node once the children left can't bring it back
+  // inside the window, given that every score is in [0, max]
+  STAR1,
+  // STAR1, but first probe every child with just its first swipe
+  // to get a lower bound on it
+  STAR2,
+};
+
+struct ChanceModel {
+  // relative odds of the next color after a placement, a tracked
+  // deck's own counts are used instead
+  double red = 1;
+  double blue = 1;
+  double white = 1;
+  // odds of a white card being a bonus card, when there are any. with
+  // a tracked deck, the odds of the next card being one when it can be
+  double bonus_card = 1.0 / 21;
+  // branches less likely than this are evaluated instead of searched
+  double probability_cutoff = 0;
+  ChancePruning pruning = ChancePruning::STAR1;
+};
+
+// fills `moves` with every computer's move after `move` and
+// `probabilities` with how likely each one is according to `model`,
+// returns how many there are. the card is placed on a uniformly
+// random free cell
+static
+size_t
+computer_move_probabilities(const ChanceModel & model,
+                            const BitBoard & board, PlayerMove move,
+                            ComputerMove (&moves)[MAX_COMPUTER_MOVES],
+                            double (&probabilities)[MAX_COMPUTER_MOVES]) {
+  auto placements = possible_computer_card_placements_post_shift(board, move);
+
+  // every free cell gets the same cards, a 1, 2 or 3 first unless
+  // the deck has run out of 3s and then any bonus cards
+  size_t positions = std::count_if(placements.begin(), placements.end(), [&] (const CardPlacement & p) {
+      return p.card == placements[0].card;
+    });
+  auto cards = placements.size() / positions;
+  auto small_card = placements[0].card.value() <= 3;
+  auto bonus_cards = cards - small_card;
+
+  const auto & deck = board.deck();
+  auto max_value = deck.tracked() ? board.max_card().value() : 0;
+
+  size_t count = 0;
+  for (const auto & placement : placements) {
+    double card_probability = (cards == 1 ? 1 :
+                               !small_card ? 1.0 / cards :
+                               placement.card.value() <= 3 ? 1 - model.bonus_card :
+                               model.bonus_card / bonus_cards);
+
+    double odds[3] = {model.red, model.blue, model.white};
+    if (deck.tracked()) {
+      auto after = deck.placed(placement.card);
+      double total = after.ones + after.twos + after.threes;
+      auto bonus = (Deck::bonus_cards_possible(std::max(max_value, placement.card.value()))
+                    ? model.bonus_card : 0);
+      odds[0] = (1 - bonus) * after.twos / total;
+      odds[1] = (1 - bonus) * after.ones / total;
+      odds[2] = (1 - bonus) * after.threes / total + bonus;
+    }
+    auto total_odds = odds[0] + odds[1] + odds[2];
+
+    NextColor colors[3];
+    auto color_count = possible_next_colors(deck, placement.card, max_value, colors);
+    for (size_t c = 0; c < color_count; ++c) {
+      moves[count] = {placement, colors[c]};
+      probabilities[count] = card_probability / positions * odds[static_cast<size_t>(colors[c])] / total_odds;
+      ++count;
+    }
+  }
+
+  return count;
+}
+
+typedef double expected_score_t;
+
+struct ExpectimaxResult {
+  PlayerMove best_move;
+  expected_score_t score;
+};
+
+// death is worth the least a board can score
+const expected_score_t EXPECTIMAX_DEATH_SCORE = 0;
+
+// table_board_evaluator() with an upper bound on the score of any
+// board a few swipes away, which is what STAR1 and STAR2 prune with.
+// a board without friction scores like one with a friction of 1
+// instead of the maximum so that the bound is useful
+struct BoundedTableEvaluator {
+  board_score_t
+  operator()(const BitBoard & board) const {
+    auto friction = best_friction_kernel.friction(board);
+    return (board.max_card().value() << SCORE_FRACTION_BITS) / std::max(friction, 1u);
+  }
+
+  board_score_t
+  operator()(const LeafFeatures & features) const {
+    auto max_value = BitBoard::rank_to_card(features.max_rank).value();
+    return (max_value << SCORE_FRACTION_BITS) / std::max(features.friction, 1u);
+  }
+
+  // a swipe raises the max card by at most one rank and the
+  // computer never places a card bigger than it
+  board_score_t
+  upper_bound(const BitBoard & board, unsigned depth) const {
+    // std::min() takes a reference, which MAX_RANK has no definition for
+    unsigned max_rank = BitBoard::MAX_RANK;
+    auto rank = std::min(board.max_rank() + depth, max_rank);
+    return BitBoard::rank_to_card(rank).value() << SCORE_FRACTION_BITS;
+  }
+};
+
+template <class F>
+ExpectimaxResult
+inner_expectimax(F evaluator, SearchContext & ctx, const ChanceModel & model,
+                 const BitBoard & board, unsigned depth, double probability,
+                 expected_score_t alpha, expected_score_t beta, bool probe);
+
+// the expected score after the player swipes `move` and leaves `board`.
+// fail-soft: a score <= alpha is an upper bound and one >= beta
+// is a lower bound
+template <class F>
+expected_score_t
+chance_node(F evaluator, SearchContext & ctx, const ChanceModel & model,
+            const BitBoard & board, PlayerMove move, unsigned depth, double probability,
+            expected_score_t alpha, expected_score_t beta) {
+  const auto L = EXPECTIMAX_DEATH_SCORE;
+  const expected_score_t U = evaluator.upper_bound(board, depth - 1);
+
+  ComputerMove moves[MAX_COMPUTER_MOVES];
+  double probabilities[MAX_COMPUTER_MOVES];
+  auto count = computer_move_probabilities(model, board, move, moves, probabilities);
+  assert(count);
+
+  auto search_child = [&] (size_t i, expected_score_t child_alpha, expected_score_t child_beta,
+                           bool probe) {
+    auto board2 = board;
+    board2.computers_move(move, moves[i].placement, moves[i].next_color);
+    auto child_probability = probability * probabilities[i];
+    auto child_depth = child_probability < model.probability_cutoff ? 0 : depth - 1;
+    return inner_expectimax(evaluator, ctx, model, board2, child_depth, child_probability,
+                            std::max(child_alpha, L), std::min(child_beta, U), probe).score;
+  };
+
+  // the lower bound on each child and the sum of those weighted
+  // by probability for the children not searched yet
+  expected_score_t lower[MAX_COMPUTER_MOVES];
+  std::fill(lower, lower + count, L);
+  expected_score_t rest_lower = L;
+
+  auto star1 = model.pruning != ChancePruning::NONE;
+  auto probing = model.pruning == ChancePruning::STAR2 && depth > 1;
+  if (probing) {
+    for (size_t i = 0; i < count; ++i) {
+      if (probability * probabilities[i] < model.probability_cutoff) continue;
+      // the probe never fails low so it's always a lower bound
+      auto others = rest_lower - probabilities[i] * lower[i];
+      auto score = search_child(i, L, (beta - others) / probabilities[i], true);
+      rest_lower = others + probabilities[i] * score;
+      lower[i] = score;
+      if (rest_lower >= beta) return rest_lower;
+    }
+  }
+
+  expected_score_t sum = 0;
+  double rest_probability = 1;
+  for (size_t i = 0; i < count; ++i) {
+    auto p = probabilities[i];
+    rest_probability -= p;
+    rest_lower -= p * lower[i];
+
+    auto child_alpha = -std::numeric_limits<expected_score_t>::infinity();
+    auto child_beta = std::numeric_limits<expected_score_t>::infinity();
+    if (star1) {
+      child_alpha = (alpha - sum - std::max(rest_probability, 0.0) * U) / p;
+      child_beta = (beta - sum - rest_lower) / p;
+    }
+
+    // the window may already be out of reach without searching
+    if (child_alpha >= U) return sum + (p + std::max(rest_probability, 0.0)) * U;
+    if (child_beta <= L) return sum + p * L + rest_lower;
+
+    auto score = search_child(i, child_alpha, child_beta, false);
+    if (score <= child_alpha) return sum + p * score + std::max(rest_probability, 0.0) * U;
+    if (score >= child_beta) return sum + p * score + rest_lower;
+    sum += p * score;
+  }
+
+  return sum;
+}
+
+// the player's node of the expectimax search. a probe only looks at
+// the first swipe, which gives a lower bound on the node
+template <class F>
+ExpectimaxResult
+inner_expectimax(F evaluator, SearchContext & ctx, const ChanceModel & model,
+                 const BitBoard & board, unsigned depth, double probability,
+                 expected_score_t alpha, expected_score_t beta, bool probe) {
+  ctx.visit();
+
+  if (!depth) {
+    auto features = leaf_features(board);
+    return {PlayerMove::UNKNOWN,
+        features.can_move ? evaluator(features) : EXPECTIMAX_DEATH_SCORE};
+  }
+
+  Swipe swipes[4];
+  auto swipe_count = order_swipes(evaluator, ctx, board, PlayerMove::UNKNOWN, depth, swipes);
+  if (!swipe_count) return {PlayerMove::UNKNOWN, EXPECTIMAX_DEATH_SCORE};
+  if (probe) swipe_count = 1;
+
+  ExpectimaxResult toret = {PlayerMove::UNKNOWN, -std::numeric_limits<expected_score_t>::infinity()};
+  for (size_t i = 0; i < swipe_count; ++i) {
+    auto board2 = board.with_cells(swipes[i].cells);
+    auto score = chance_node(evaluator, ctx, model, board2, swipes[i].move, depth, probability,
+                             std::max(alpha, toret.score), beta);
+    if (score > toret.score) toret = {swipes[i].move, score};
+    if (toret.score >= beta) break;
+  }
+
+  return toret;
+}
+
+template <class F>
+MinimaxResult
+run_expectimax(F evaluator, SearchContext & ctx, const ChanceModel & model,
+               const BitBoard & board, unsigned depth) {
+  auto res = inner_expectimax(evaluator, ctx, model, board, depth, 1,
+                              EXPECTIMAX_DEATH_SCORE, evaluator.upper_bound(board, depth), false);
+  // scores are in [0, max] so they fit back into a board_score_t
+  return {res.best_move, static_cast<board_score_t>(std::lround(res.score)),
+      res.score <= EXPECTIMAX_DEATH_SCORE};
+}
+
+struct SearchLimits {
+  // 0 means unlimited for each of these, though
+  // at least one of them has to be set
+  unsigned max_depth;
+  std::chrono::milliseconds time_limit;
+  unsigned long long node_limit;
+};
+
+struct SearchResult {
+  PlayerMove best_move;
+  board_score_t score;
+  bool death_guaranteed;
+  // the deepest search that completed
+  unsigned depth;
+  unsigned long long nodes;
+  std::chrono::microseconds elapsed;
+  unsigned long long collapsed_leaves;
+};
+
+// an anytime search: calls search(depth) for depth 1, 2, 3, ...
+// until it runs out of time or nodes and returns the result of
+// the deepest search that completed
+template <class Search>
+SearchResult
+run_iterative_deepening(SearchContext & ctx, const SearchLimits & limits, Search search) {
+  assert(limits.max_depth || limits.time_limit.count() || limits.node_limit);
+
+  auto start = SearchContext::clock::now();
+  ctx.nodes = 0;
+  ctx.collapsed_leaves = 0;
+  SEARCH_STATS(ctx.stats = {};)
+  ctx.deadline = (limits.time_limit.count()
+                  ? start + limits.time_limit
+                  : SearchContext::clock::time_point::max());
+  ctx.node_limit = (limits.node_limit
+                    ? limits.node_limit
+                    : std::numeric_limits<unsigned long long>::max());
+
+  auto max_depth = limits.max_depth ? std::min(limits.max_depth, MAX_SEARCH_DEPTH) : MAX_SEARCH_DEPTH;
+
+  SearchResult toret = {PlayerMove::UNKNOWN, std::numeric_limits<board_score_t>::lowest(), true, 0, 0, {}, 0};
+  for (unsigned depth = 1; depth <= max_depth; ++depth) {
+    // the first iteration is cheap and always completes so
+    // there is a move to make no matter how tight the limits are
+    ctx.abortable = depth > 1;
+
+    SEARCH_STATS(auto iteration_start = SearchContext::clock::now();
+                 auto iteration_nodes = ctx.nodes;)
+    MinimaxResult res;
+    try {
+      res = search(depth);
+    }
+    catch (const SearchAborted &) {
+      break;
+    }
+    SEARCH_STATS(ctx.stats.iteration_ms[depth] = std::chrono::duration<double, std::milli>(
+                   SearchContext::clock::now() - iteration_start).count();
+                 ctx.stats.iteration_nodes[depth] = ctx.nodes - iteration_nodes;)
+
+    toret.best_move = res.best_move;
+    toret.score = res.move_score;
+    toret.death_guaranteed = res.death_guaranteed;
+    toret.depth = depth;
+
+    // searching deeper won't change a lost position
+    if (res.move_score == std::numeric_limits<board_score_t>::lowest()) break;
+  }
+
+  ctx.abortable = false;
+  toret.nodes = ctx.nodes;
+  toret.collapsed_leaves = ctx.collapsed_leaves;
+  toret.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(SearchContext::clock::now() - start);
+  return toret;
+}
+
+// a plain fixed depth search unless there is a time or node budget
+template <class Search>
+SearchResult
+search_to_limits(SearchContext & ctx, const SearchLimits & limits, Search search) {
+  if (limits.time_limit.count() || limits.node_limit) {
+    return run_iterative_deepening(ctx, limits, search);
+  }
+
+  auto start = SearchContext::clock::now();
+  ctx.nodes = 0;
+  ctx.collapsed_leaves = 0;
+  SEARCH_STATS(ctx.stats = {};)
+  auto depth = std::min(limits.max_depth, MAX_SEARCH_DEPTH);
+  auto res = search(depth);
+  SEARCH_STATS(ctx.stats.iteration_ms[depth] = std::chrono::duration<double, std::milli>(
+                 SearchContext::clock::now() - start).count();
+               ctx.stats.iteration_nodes[depth] = ctx.nodes;)
+  return {res.best_move, res.move_score, res.death_guaranteed, depth, ctx.nodes,
+      std::chrono::duration_cast<std::chrono::microseconds>(SearchContext::clock::now() - start),
+      ctx.collapsed_leaves};
+}
+
+// MTD(f): every search has a null window and either raises the lower
+// bound on the score or lowers the upper one, starting from `guess`,
+// until they meet. a last search with a window just around the score
+// picks the move a full window search would, ties included
+template <class F>
+MinimaxResult
+run_mtdf(F evaluator, SearchContext & ctx, const BitBoard & root, zobrist_t hash,
+         unsigned depth, board_score_t guess) {
+  const auto lowest = std::numeric_limits<board_score_t>::lowest();
+  const auto highest = std::numeric_limits<board_score_t>::max();
+  auto lower = lowest, upper = highest;
+  auto score = guess;
+  // keeping beta between the bounds makes every search move one of
+  // them, even when entries from deeper searches don't quite agree
+  while (lower < upper) {
+    auto beta = std::min(std::max(score, board_score_t(lower + 1)), upper);
+    score = inner_alphabeta(evaluator, ctx, root, hash, depth, beta - 1, beta).move_score;
+    if (score < beta) upper = score;
+    else lower = score;
+  }
+  return inner_alphabeta(evaluator, ctx, root, hash, depth,
+                         lower == lowest ? lower : lower - 1,
+                         lower == highest ? lower : lower + 1);
+}
+
+// searches the root to `depth` the way ctx.driver says to. `guess`
+// is only for MTD(f), the score of the last iteration is a good one
+template <class F>
+MinimaxResult
+search_root(F evaluator, SearchContext & ctx, const BitBoard & root, zobrist_t hash,
+            unsigned depth, board_score_t guess) {
+  if (ctx.driver == SearchDriver::MTDF) {
+    return run_mtdf(evaluator, ctx, root, hash, depth, guess);
+  }
+  return inner_alphabeta(evaluator, ctx, root, hash, depth,
+                         std::numeric_limits<board_score_t>::lowest(),
+                         std::numeric_limits<board_score_t>::max());
+}
+
+// PVS and MTD(f) search nodes again, without a table of their
+// own they get one this big for the search
+const unsigned DRIVER_CACHE_SIZE = 16;
+
+template <class F>
+SearchResult
+search_position(F evaluator, SearchContext & ctx,
+                const Board & board, const SearchLimits & limits) {
+  BitBoard root(board);
+  auto hash = zobrist_hash(root);
+
+  struct Cache {
+    SearchContext & ctx;
+    std::unique_ptr<TranspositionTable> tt;
+
+    ~Cache() {
+      if (tt) ctx.tt = nullptr;
+    }
+  } cache = {ctx, nullptr};
+  if (!ctx.tt && ctx.driver != SearchDriver::ALPHABETA) {
+    cache.tt.reset(new TranspositionTable(DRIVER_CACHE_SIZE));
+    ctx.tt = cache.tt.get();
+  }
+
+  auto guess = evaluator(root);
+  return search_to_limits(ctx, limits, [&] (unsigned depth) {
+      auto res = search_root(evaluator, ctx, root, hash, depth, guess);
+      guess = res.move_score;
+      return res;
+    });
+}
+
+// the evaluator needs an upper_bound() like BoundedTableEvaluator
+template <class F>
+SearchResult
+search_position_expectimax(F evaluator, SearchContext & ctx, const Board & board,
+                           const SearchLimits & limits, const ChanceModel & model) {
+  BitBoard root(board);
+  return search_to_limits(ctx, limits, [&] (unsigned depth) {
+      return run_expectimax(evaluator, ctx, model, root, depth);
+    });
+}
+
+Board
+read_board_from_human_input(std::istream & is) {
+  // first read next color
+  std::string next_color_str;
+  is >> next_color_str;
+  if (!is) throw std::runtime_error("input valid");
+  auto next_color = human_string_to_next_color(next_color_str);
+
+  std::vector<CardPlacement> board_init;
+  for (unsigned j = 0; j < Board::BOARD_SIZE; ++j) {
+    for (unsigned i = 0; i < Board::BOARD_SIZE; ++i) {
+      unsigned card_value;
+      is >> card_value;
+      if (!is) throw std::runtime_error("invalid card!");
+      if (!card_value) continue;
+      Card c = card_value;
+      board_init.push_back({c, {i, j}});
+    }
+  }
+
+  return { board_init, next_color };
+}
+
+// the deck a game from `board` is drawing from: a new game's board
+// was dealt from the first deck, anything else gets a fresh one
+#ifndef EMSCRIPTEN
+
+static
+Deck
+starting_deck(const Board & board) {
+  auto toret = Deck::fresh();
+  for (unsigned y = 0; y < Board::BOARD_SIZE; ++y) {
+    for (unsigned x = 0; x < Board::BOARD_SIZE; ++x) {
+      auto value = board[{x, y}].value();
+      if (!value) continue;
+      auto count = (value == 1 ? &toret.ones :
+                    value == 2 ? &toret.twos :
+                    value == 3 ? &toret.threes :
+                    nullptr);
+      if (!count || !*count) return Deck::fresh();
+      --*count;
+    }
+  }
+  if (!toret.tracked() || !toret.can_show(board.next_color(), board.max_card().value())) {
+    return Deck::fresh();
+  }
+  return toret;
+}
+
+#endif
+
+#ifdef EMSCRIPTEN
+
+extern "C" {
+
+void
+web_worker(char *data, size_t size) {
+  unsigned level;
+  std::memcpy(&level, data, sizeof(level));
+  auto is = std::istringstream(std::string(data + sizeof(level), data + size));
+  auto board = read_board_from_human_input(is);
+  static TranspositionTable tt(14);
+  tt.clear();
+  SearchContext ctx = {&tt};
+  auto player_move = run_minimax(table_board_evaluator, ctx, board, level);
+  char response_mut[sizeof(player_move)];
+  memcpy(response_mut, &player_move, sizeof(player_move));
+  emscripten_worker_respond(response_mut, sizeof(player_move));
+}
+
+void *
+create_board(const char *textual_representation) {
+  try {
+    auto is = std::istringstream(textual_representation);
+    auto board = read_board_from_human_input(is);
+    return (void *) new Board(board);
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+
+size_t
+serialize_board(void *board, char *str, size_t size) {
+  auto board_p = (const Board *) board;
+
+  std::ostringstream serialized;
+
+  serialized << next_color_to_human_string(board_p->next_color()) << " ";
+
+  for (size_t y = 0; y < Board::BOARD_SIZE; ++y) {
+    for (size_t x = 0; x < Board::BOARD_SIZE; ++x) {
+      serialized << (*board_p)[{x, y}].value() << " ";
+    }
+  }
+
+  auto ret_string = serialized.str();
+  auto to_copy = std::min(size, ret_string.size());
+  std::memmove(str, ret_string.data(), to_copy);
+
+  return to_copy;
+}
+
+void
+free_board(void *b) {
+  delete [] (char *) b;
+}
+
+worker_handle
+create_worker(const char *url) {
+  return emscripten_create_worker(url);
+}
+
+typedef void (*my_cb_t)(const char *);
+
+void callback_js(char *data, int size, void *a) {
+  PlayerMove pm;
+  memcpy(&pm, data, size);
+  auto str_pm = to_string(pm);
+  auto cb = (my_cb_t) a;
+  cb(str_pm.c_str());
+}
+
+void
+get_next_move(worker_handle wh, void *board, my_cb_t cb, unsigned level) {
+  char serialized_board[256];
+  std::memcpy(serialized_board, &level, sizeof(level));
+  auto actual_size = serialize_board(board, serialized_board + sizeof(level), sizeof(serialized_board) - sizeof(level));
+  emscripten_call_worker(wh, "web_worker",
+                         serialized_board, actual_size + sizeof(level),
+                         callback_js, (void *) cb);
+}
+
+PlayerMove
+player_move_from_string(std::string a) {
+  PlayerMove pm;
+  if (a == "SWIPE_UP") pm = PlayerMove::SWIPE_UP;
+  else if (a == "SWIPE_DOWN") pm = PlayerMove::SWIPE_DOWN;
+  else if (a == "SWIPE_LEFT") pm = PlayerMove::SWIPE_LEFT;
+  else if (a == "SWIPE_RIGHT") pm = PlayerMove::SWIPE_RIGHT;
+  else throw std::runtime_error("bad players move");
+  return pm;
+}
+
+int
+make_computers_move(void *board,
+                    const char *players_move,
+                    unsigned card_value, size_t card_position_x, size_t card_position_y,
+                    const char *human_readable_next_color) {
+  auto board_p = (Board *) board;
+  try {
+    auto pm = player_move_from_string(players_move);
+    auto next_color = human_string_to_next_color(human_readable_next_color);
+    board_p->computers_move(pm, {card_value, {card_position_x, card_position_y}},
+                            next_color);
+    return true;
+  }
+  catch (...) {
+    return false;
+  }
+}
+
+int
+shift_board(void *board,
+            const char *players_move) {
+  auto board_p = (Board *) board;
+  try {
+    auto pm = player_move_from_string(players_move);
+    board_p->shift(pm);
+    return true;
+  }
+  catch (...) {
+    return false;
+  }
+}
+
+
+}
+
+#else
+
+// a fixed set of threads working off a queue of tasks, kept around
+// between searches so threads aren't started on every move
+class ThreadPool {
+public:
+  // a task gets the index of the thread running it and
+  // must not throw
+  typedef std::function<void (unsigned)> Task;
+
+private:
+  std::vector<std::thread> _threads;
+  std::deque<Task> _tasks;
+  std::mutex _mutex;
+  std::condition_variable _task_ready;
+  std::condition_variable _all_done;
+  size_t _running = 0;
+  bool _stopping = false;
+
+  void
+  _work(unsigned index) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+      _task_ready.wait(lock, [&] { return _stopping || !_tasks.empty(); });
+      if (_tasks.empty()) return;
+
+      auto task = std::move(_tasks.front());
+      _tasks.pop_front();
+      ++_running;
+
+      lock.unlock();
+      task(index);
+      lock.lock();
+
+      --_running;
+      if (_tasks.empty() && !_running) _all_done.notify_all();
+    }
+  }
+
+public:
+  explicit ThreadPool(unsigned threads) {
+    assert(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+      _threads.emplace_back([this, i] { _work(i); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stopping = true;
+    }
+    _task_ready.notify_all();
+    for (auto & thread : _threads) thread.join();
+  }
+
+  unsigned
+  size() const {
+    return _threads.size();
+  }
+
+  // tasks start in the order they are submitted
+  void
+  submit(Task task) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _tasks.push_back(std::move(task));
+    }
+    _task_ready.notify_one();
+  }
+
+  // blocks until every submitted task has finished
+  void
+  wait() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _all_done.wait(lock, [&] { return _tasks.empty() && !_running; });
+  }
+};
+
+enum class ParallelMode {
+  // the root's children are split between the threads
+  ROOT,
+  // every thread searches the whole tree, sharing a table
+  LAZY_SMP,
+};
+
+enum class RootSplit {
+  // one task per root swipe
+  SWIPES,
+  // one task per computer's reply to each root swipe
+  PLACEMENTS,
+};
+
+// searches the root's children on a thread pool. every thread has its
+// own transposition table, killers and history, the threads only share
+// the root's alpha and each swipe's beta. a task that starts after
+// another swipe raised alpha gets the narrower window, so swipes that
+// come later can be pruned
+class ParallelSearch {
+  ThreadPool _pool;
+  std::vector<std::unique_ptr<TranspositionTable>> _tts;
+  std::vector<SearchContext> _contexts;
+
+  static
+  void
+  _atomic_min(std::atomic<board_score_t> & a, board_score_t b) {
+    auto cur = a.load();
+    while (b < cur && !a.compare_exchange_weak(cur, b)) {}
+  }
+
+  static
+  void
+  _atomic_max(std::atomic<board_score_t> & a, board_score_t b) {
+    auto cur = a.load();
+    while (b > cur && !a.compare_exchange_weak(cur, b)) {}
+  }
+
+public:
+  // log2_tt_buckets of 0 searches without transposition tables
+  ParallelSearch(unsigned threads, unsigned log2_tt_buckets)
+    : _pool(threads) {
+    for (unsigned i = 0; i < threads; ++i) {
+      _tts.emplace_back(log2_tt_buckets ? new TranspositionTable(log2_tt_buckets) : nullptr);
+      SearchContext ctx = {_tts.back().get()};
+      _contexts.push_back(ctx);
+    }
+  }
+
+  unsigned
+  threads() const {
+    return _pool.size();
+  }
+
+  // forgets everything learned about previous positions
+  void
+  clear() {
+    for (size_t i = 0; i < _contexts.size(); ++i) {
+      if (_tts[i]) _tts[i]->clear();
+      SearchContext ctx = {_tts[i].get()};
+      _contexts[i] = ctx;
+    }
+  }
+
+  // keeps the tables for the next search
+  void
+  next_generation() {
+    for (size_t i = 0; i < _contexts.size(); ++i) {
+      if (_tts[i]) _tts[i]->next_generation();
+      SearchContext ctx = {_tts[i].get()};
+      _contexts[i] = ctx;
+    }
+  }
+
+  // every thread's table statistics since the last clear()
+  // or next_generation()
+  TableStats
+  tt_stats() const {
+    TableStats toret;
+    for (const auto & ctx : _contexts) toret += ctx.tt_stats;
+    return toret;
+  }
+
+  // the same move and score as inner_alphabeta() on `board` with the
+  // widest window. the limits in ctx apply to the whole search, with
+  // the node limit split evenly between the threads, and the nodes
+  // every thread visited are added to ctx.nodes
+  template <class F>
+  MinimaxResult
+  search(F evaluator, SearchContext & ctx, const BitBoard & board,
+         zobrist_t hash, unsigned depth, RootSplit split) {
+    assert(depth);
+    const auto lowest = std::numeric_limits<board_score_t>::lowest();
+
+    struct RootSwipe {
+      PlayerMove move;
+      // the board after the swipe
+      BitBoard::cells_type cells;
+      zobrist_t hash;
+      std::vector<ComputerMove> replies;
+      // the lowest score any reply got so far, exact unless refuted
+      std::atomic<board_score_t> beta;
+      // some reply got a score below alpha
+      std::atomic<bool> refuted;
+      std::atomic<bool> death_guaranteed;
+      std::atomic<size_t> replies_left;
+    };
+
+    Swipe swipes[4];
+    auto swipe_count = order_swipes(evaluator, ctx, board, PlayerMove::UNKNOWN, depth, swipes);
+    if (!swipe_count) return {PlayerMove::UNKNOWN, lowest, true};
+    if (ctx.symmetry) {
+      swipe_count = merge_symmetric_swipes(swipes, swipe_count,
+                                           canonicalize(board.raw_cells()).symmetries);
+    }
+
+    RootSwipe root[4];
+    for (size_t i = 0; i < swipe_count; ++i) {
+      auto & rs = root[i];
+      rs.move = swipes[i].move;
+      rs.cells = swipes[i].cells;
+      rs.hash = zobrist_update_cells(hash, board.raw_cells(), rs.cells);
+
+      auto board2 = board.with_cells(rs.cells);
+      auto placements = possible_computer_card_placements_post_shift(board2, rs.move);
+      size_t order[MAX_CARD_PLACEMENTS];
+      order_placements(evaluator, ctx, board2, rs.move, depth, placements, order);
+      auto max_value = board2.deck().tracked() ? board2.max_card().value() : 0;
+      for (size_t j = 0; j < placements.size(); ++j) {
+        NextColor colors[3];
+        auto color_count = possible_next_colors(board2.deck(), placements[order[j]].card,
+                                                max_value, colors);
+        for (size_t c = 0; c < color_count; ++c) {
+          rs.replies.push_back({placements[order[j]], colors[c]});
+        }
+      }
+
+      rs.beta = std::numeric_limits<board_score_t>::max();
+      rs.refuted = false;
+      rs.death_guaranteed = true;
+      rs.replies_left = rs.replies.size();
+    }
+
+    std::atomic<board_score_t> alpha(lowest);
+    std::atomic<bool> stop(false);
+
+    auto node_limit = (ctx.node_limit == std::numeric_limits<unsigned long long>::max()
+                       ? ctx.node_limit
+                       : (ctx.node_limit - std::min(ctx.node_limit, ctx.nodes)) / threads() + 1);
+    for (auto & worker : _contexts) {
+      worker.nodes = 0;
+      worker.collapsed_leaves = 0;
+      SEARCH_STATS(worker.stats = {};)
+      worker.ordering = ctx.ordering;
+      worker.symmetry = ctx.symmetry;
+      worker.deeper_cutoffs = ctx.deeper_cutoffs;
+      worker.batch_leaves = ctx.batch_leaves;
+      worker.selectivity = ctx.selectivity;
+      worker.driver = ctx.driver;
+      worker.abortable = ctx.abortable;
+      worker.deadline = ctx.deadline;
+      worker.node_limit = node_limit;
+      worker.stop = &stop;
+    }
+
+    auto search_reply = [&] (unsigned thread, RootSwipe & rs, const ComputerMove & cm) {
+      if (stop || rs.refuted) return;
+
+      // ties go to the earliest swipe in UP, DOWN, LEFT, RIGHT order,
+      // which is only decided at the end, so a swipe that ties alpha
+      // mustn't be refuted. nothing is below the lowest score
+      auto a = alpha.load();
+      auto refutable = a > lowest;
+      auto search_alpha = refutable ? a - 1 : a;
+      auto beta = rs.beta.load();
+      if (refutable && beta <= search_alpha) {
+        rs.refuted = true;
+        return;
+      }
+
+      auto board2 = board.with_cells(rs.cells);
+      board2.computers_move(rs.move, cm.placement, cm.next_color);
+      auto & worker = _contexts[thread];
+      auto hash2 = (worker.tt
+                    ? (zobrist_update_cells(rs.hash, rs.cells, board2.raw_cells()) ^
+                       zobrist_color(board.next_color()) ^ zobrist_color(cm.next_color) ^
+                       zobrist_deck(board.deck()) ^ zobrist_deck(board2.deck()))
+                    : 0);
+
+      MinimaxResult res;
+      try {
+        res = inner_alphabeta(evaluator, worker, board2, hash2, depth - 1, search_alpha, beta);
+      }
+      catch (const SearchAborted &) {
+        stop = true;
+        return;
+      }
+
+      if (!res.death_guaranteed) rs.death_guaranteed = false;
+      _atomic_min(rs.beta, res.move_score);
+      if (refutable && res.move_score <= search_alpha) rs.refuted = true;
+    };
+
+    auto finish_replies = [&] (RootSwipe & rs, size_t count) {
+      if ((rs.replies_left -= count) || rs.refuted || stop) return;
+      // every reply has been searched, this swipe's score is exact
+      _atomic_max(alpha, rs.beta);
+    };
+
+    for (size_t i = 0; i < swipe_count; ++i) {
+      auto & rs = root[i];
+      if (split == RootSplit::SWIPES) {
+        _pool.submit([&] (unsigned thread) {
+            for (const auto & cm : rs.replies) search_reply(thread, rs, cm);
+            finish_replies(rs, rs.replies.size());
+          });
+      }
+      else {
+        for (const auto & cm : rs.replies) {
+          _pool.submit([&] (unsigned thread) {
+              search_reply(thread, rs, cm);
+              finish_replies(rs, 1);
+            });
+        }
+      }
+    }
+    _pool.wait();
+
+    for (const auto & worker : _contexts) {
+      ctx.nodes += worker.nodes;
+      ctx.collapsed_leaves += worker.collapsed_leaves;
+      SEARCH_STATS(ctx.stats += worker.stats;)
+    }
+    if (stop) throw SearchAborted();
+
+    MinimaxResult toret = {PlayerMove::UNKNOWN, lowest, true};
+    for (size_t i = 0; i < swipe_count; ++i) {
+      const auto & rs = root[i];
+      if (!rs.death_guaranteed) toret.death_guaranteed = false;
+      if (rs.refuted) continue;
+      if (toret.best_move == PlayerMove::UNKNOWN || rs.beta > toret.move_score ||
+          (rs.beta == toret.move_score && rs.move < toret.best_move)) {
+        toret.best_move = rs.move;
+        toret.move_score = rs.beta;
+      }
+    }
+
+    return toret;
+  }
+};
+
+// Lazy SMP: every thread runs the same iterative deepening search from
+// the root and they only cooperate through one shared transposition
+// table. helpers start out with different swipe orders and every other
+// one starts a ply deeper so they don't search the same nodes in
+// lockstep. what they store lets the main thread cut off or order
+// better, its result is the one returned
+class LazySmpSearch {
+  ThreadPool _pool;
+  TranspositionTable _tt;
+  std::vector<SearchContext> _contexts;
+
+public:
+  LazySmpSearch(unsigned threads, unsigned log2_tt_buckets)
+    : _pool(threads), _tt(log2_tt_buckets) {
+    SearchContext ctx = {&_tt};
+    _contexts.assign(threads, ctx);
+  }
+
+  unsigned
+  threads() const {
+    return _pool.size();
+  }
+
+  void
+  clear() {
+    _tt.clear();
+  }
+
+  // keeps the table for the next search
+  void
+  next_generation() {
+    _tt.next_generation();
+  }
+
+  // every thread's table statistics from the last search
+  TableStats
+  tt_stats() const {
+    TableStats toret;
+    for (const auto & ctx : _contexts) toret += ctx.tt_stats;
+    return toret;
+  }
+
+  // the main thread searches within `limits`, the helpers search until
+  // it's done. nodes are counted over every thread and the move
+  // ordering, symmetry and cutoff settings are taken from `like`
+  template <class F>
+  SearchResult
+  search(F evaluator, const SearchContext & like, const Board & board, const SearchLimits & limits) {
+    BitBoard root(board);
+    auto hash = zobrist_hash(root);
+    auto max_depth = limits.max_depth ? std::min(limits.max_depth, MAX_SEARCH_DEPTH) : MAX_SEARCH_DEPTH;
+    std::atomic<bool> stop(false);
+
+    for (size_t i = 0; i < _contexts.size(); ++i) {
+      SearchContext ctx = {&_tt};
+      ctx.ordering = like.ordering;
+      ctx.symmetry = like.symmetry;
+      ctx.deeper_cutoffs = like.deeper_cutoffs;
+      ctx.batch_leaves = like.batch_leaves;
+      ctx.selectivity = like.selectivity;
+      // the helpers only fill the table, they don't need MTD(f)
+      ctx.driver = i ? SearchDriver::ALPHABETA : like.driver;
+      if (i) {
+        ctx.abortable = true;
+        ctx.stop = &stop;
+        // small enough that the first real history update outweighs it
+        auto seed = splitmix64(i);
+        for (auto & h : ctx.history) {
+          h = seed & 3;
+          seed >>= 2;
+        }
+      }
+      _contexts[i] = ctx;
+    }
+
+    SearchResult toret;
+    auto guess = evaluator(root);
+    _pool.submit([&] (unsigned) {
+        // iterative deepening even without a time limit so the helpers
+        // and the main thread fill the table with the same depths
+        toret = run_iterative_deepening(_contexts[0], {max_depth, limits.time_limit, limits.node_limit},
+                                        [&] (unsigned depth) {
+            auto res = search_root(evaluator, _contexts[0], root, hash, depth, guess);
+            guess = res.move_score;
+            return res;
+          });
+        stop = true;
+      });
+
+    for (size_t i = 1; i < _contexts.size(); ++i) {
+      _pool.submit([&, i] (unsigned) {
+          auto & ctx = _contexts[i];
+          try {
+            for (auto depth = 1 + i % 2; depth <= max_depth && !stop; ++depth) {
+              inner_alphabeta(evaluator, ctx, root, hash, depth,
+                              std::numeric_limits<board_score_t>::lowest(),
+                              std::numeric_limits<board_score_t>::max());
+            }
+          }
+          catch (const SearchAborted &) {}
+        });
+    }
+    _pool.wait();
+
+    for (size_t i = 1; i < _contexts.size(); ++i) {
+      toret.nodes += _contexts[i].nodes;
+      toret.collapsed_leaves += _contexts[i].collapsed_leaves;
+    }
+    return toret;
+  }
+};
+
+template <class F>
+SearchResult
+search_position_parallel(F evaluator, SearchContext & ctx, ParallelSearch & parallel,
+                         const Board & board, const SearchLimits & limits, RootSplit split) {
+  BitBoard root(board);
+  auto hash = zobrist_hash(root);
+  return search_to_limits(ctx, limits, [&] (unsigned depth) {
+      return parallel.search(evaluator, ctx, root, hash, depth, split);
+    });
+}
+
+class InvalidCardPlacementLine : public std::exception {};
+class FinishedEnteringCardPlacement : public std::exception {};
+class EOFError : public std::exception {};
+
+static
+CardPlacement
+get_card_placement_line(decltype(std::cin) & cin_, bool allow_done) {
+  std::string line;
+  getline(cin_, line);
+
+  if (cin_.eof()) throw EOFError();
+
+  if (allow_done && line == "done") throw FinishedEnteringCardPlacement();
+
+  std::istringstream is(line);
+  unsigned card_value;
+  CardPosition pos;
+  is >> card_value >> pos.x >> pos.y;
+
+  if (is.fail() || !Board::is_valid_card_position(pos)) throw InvalidCardPlacementLine();
+
+  return { card_value, pos };
+}
+
+struct ComputersResponse {
+  CardPlacement card_placement;
+  NextColor next_color;
+};
+
+class PrintCurrentBoard {
+public:
+  void
+  current_board(const Board & board) {
+    board.print_board(std::cout);
+    std::cout << std::endl;
+  }
+
+  // where run_game() says what it's doing
+  std::ostream &
+  log() {
+    return std::cout;
+  }
+};
+
+class ConsoleGameIO : public PrintCurrentBoard {
+public:
+  static
+  NextColor
+  get_next_color() {
+    while (true) {
+      std::string line;
+      getline(std::cin, line);
+      if (!std::cin) throw std::runtime_error("eof");
+
+      switch (line[0]) {
+      case 'r': return NextColor::RED; break;
+      case 'b': return NextColor::BLUE; break;
+      case 'w': return NextColor::WHITE; break;
+      default: {
+        std::cout << "not a valid color, try again" << std::endl;
+        continue;
+      }
+      }
+      break;
+    }
+  }
+
+  ComputersResponse
+  get_computers_response(const Board & board, PlayerMove pm, bool error) {
+    (void) pm;
+    (void) board;
+    if (error) {
+      std::cout << "Computer could not have moved there, try again" << std::endl;
+    }
+    std::cout << "Where did the computer move?" << std::endl;
+    auto placement = get_card_placement_line(std::cin, false);
+
+    std::cout << "What is the next Color?" << std::endl;
+    auto next_color = get_next_color();
+
+    return {placement, next_color};
+  }
+};
+
+// the computer places its card on a random cell and cycles through
+// the colors. the same seed plays the same game
+class VirtualGameIO : public PrintCurrentBoard {
+  std::mt19937 _rng;
+  unsigned _counter = 0;
+
+public:
+  explicit VirtualGameIO(unsigned seed) : _rng(seed) {}
+
+  ComputersResponse
+  get_computers_response(const Board & board, PlayerMove pm, bool error) {
+    (void) error;
+    assert(!error);
+    auto toret = possible_computer_card_placements_post_shift(board, pm);
+    auto placement = toret[_rng() % toret.size()];
+
+    NextColor next_color;
+    switch (_counter++ % 3) {
+    case 0: next_color = NextColor::BLUE; break;
+    case 1: next_color = NextColor::RED; break;
+    case 2: next_color = NextColor::WHITE; break;
+    default: assert(false); next_color = NextColor::WHITE;
+    }
+
+    return {placement, next_color};
+  }
+};
+
+// a VirtualGameIO that keeps quiet, for playing lots of games at once
+class SelfPlayGameIO : public VirtualGameIO {
+public:
+  using VirtualGameIO::VirtualGameIO;
+
+  void
+  current_board(const Board &) {}
+
+  std::ostream &
+  log() {
+    // no buffer, so it throws everything away
+    thread_local std::ostream discard(nullptr);
+    return discard;
+  }
+};
+
+struct SolverOptions {
+  // a fixed depth search unless there's a time or node limit,
+  // then max_depth is how deep iterative deepening may go
+  SearchLimits limits = {6, std::chrono::milliseconds(0), 0};
+  // log2 of the number of transposition table buckets, 0 disables it
+  unsigned tt_size = 19;
+  MoveOrdering ordering = MoveOrdering::HEURISTIC;
+  bool symmetry = true;
+  // keep the transposition table from one move to the next
+  bool reuse_tree = true;
+  // evaluate the last ply in batches, see SearchContext
+  bool batch_leaves = true;
+  // minimax only, see Selectivity and SearchDriver
+  Selectivity selectivity = {};
+  SearchDriver driver = SearchDriver::ALPHABETA;
+  SearchEngine engine = SearchEngine::MINIMAX;
+  // only used by the expectimax engine
+  ChanceModel chance;
+  // more than one searches in parallel, minimax only
+  unsigned threads = 1;
+  ParallelMode parallel = ParallelMode::ROOT;
+  RootSplit split = RootSplit::PLACEMENTS;
+  // search the positions the computer's response may lead to
+  // while waiting for it
+  bool ponder = false;
+  bool print_tt_stats = false;
+  bool print_search_info = false;
+  // one JSON line per search, see print_search_stats()
+  SEARCH_STATS(std::ostream *search_stats = nullptr;)
+};
+
+// searches the positions after each of the computer's possible
+// responses, most likely first, while the game waits for the real
+// one. every thread has its own table so that a position that was
+// only partly searched can hand its table over to the real search
+class Ponderer {
+  struct Pondered {
+    BitBoard board;
+    bool started;
+    bool complete;
+    unsigned thread;
+    SearchResult result;
+  };
+
+  const SolverOptions & _options;
+  std::vector<std::unique_ptr<TranspositionTable>> _tables;
+  std::vector<Pondered> _pondered;
+  std::atomic<bool> _stop;
+  // destroyed first so no task outlives the rest
+  ThreadPool _pool;
+
+  void
+  _ponder(size_t i, unsigned thread) {
+    if (_stop) return;
+
+    auto & pondered = _pondered[i];
+    pondered.started = true;
+    pondered.thread = thread;
+
+    SearchContext ctx = {_tables[thread].get()};
+    ctx.ordering = _options.ordering;
+    ctx.symmetry = _options.symmetry;
+    ctx.batch_leaves = _options.batch_leaves;
+    ctx.selectivity = _options.selectivity;
+    ctx.driver = _options.driver;
+    ctx.stop = &_stop;
+    auto board = pondered.board.to_board();
+    auto & limits = _options.limits;
+    if (_options.engine == SearchEngine::EXPECTIMAX) {
+      BoundedTableEvaluator evaluator;
+      BitBoard root(board);
+      pondered.result = run_iterative_deepening(ctx, limits, [&] (unsigned depth) {
+          return run_expectimax(evaluator, ctx, _options.chance, root, depth);
+        });
+    }
+    else {
+      BitBoard root(board);
+      auto hash = zobrist_hash(root);
+      auto guess = table_board_evaluator(root);
+      pondered.result = run_iterative_deepening(ctx, limits, [&] (unsigned depth) {
+          auto res = search_root(table_board_evaluator, ctx, root, hash, depth, guess);
+          guess = res.move_score;
+          return res;
+        });
+    }
+
+    // only a search that reached the depth the real one would have
+    // can stand in for it, a budget is only used up if nothing stopped it
+    auto & res = pondered.result;
+    pondered.complete = (res.score == std::numeric_limits<board_score_t>::lowest() ||
+                         (limits.max_depth && res.depth >= limits.max_depth) ||
+                         ((limits.time_limit.count() || limits.node_limit) && !_stop));
+  }
+
+public:
+  explicit Ponderer(const SolverOptions & options)
+    : _options(options), _stop(false), _pool(options.threads) {
+    if (options.tt_size) {
+      for (unsigned i = 0; i < options.threads; ++i) {
+        _tables.emplace_back(new TranspositionTable(options.tt_size));
+      }
+    }
+    else {
+      _tables.resize(options.threads);
+    }
+  }
+
+  ~Ponderer() {
+    _stop = true;
+  }
+
+  // `board` is after the player's `move`, before the computer's response
+  void
+  start(const Board & board, PlayerMove move) {
+    ComputerMove moves[MAX_COMPUTER_MOVES];
+    double probabilities[MAX_COMPUTER_MOVES];
+    BitBoard shifted(board);
+    auto count = computer_move_probabilities(_options.chance, shifted, move, moves, probabilities);
+
+    size_t order[MAX_COMPUTER_MOVES];
+    std::iota(order, order + count, 0);
+    std::stable_sort(order, order + count, [&] (size_t a, size_t b) {
+        return probabilities[a] > probabilities[b];
+      });
+
+    _pondered.clear();
+    for (size_t i = 0; i < count; ++i) {
+      auto next = shifted;
+      next.computers_move(move, moves[order[i]].placement, moves[order[i]].next_color);
+      if (game_is_over(next)) continue;
+      _pondered.push_back({next, false, false, 0, {}});
+    }
+
+    for (auto & table : _tables) {
+      if (table) table->clear();
+    }
+    _stop = false;
+    for (size_t i = 0; i < _pondered.size(); ++i) {
+      _pool.submit([this, i] (unsigned thread) { _ponder(i, thread); });
+    }
+  }
+
+  struct Outcome {
+    // the position was searched completely, `result` is the answer
+    bool complete;
+    // the position was at least started, its table was swapped into `tt`
+    bool started;
+    SearchResult result;
+    size_t searched;
+    size_t positions;
+  };
+
+  // stops pondering and looks for `board` among the positions searched
+  Outcome
+  finish(const Board & board, std::unique_ptr<TranspositionTable> & tt) {
+    _stop = true;
+    _pool.wait();
+
+    Outcome toret = {false, false, {}, 0, _pondered.size()};
+    BitBoard actual(board);
+    for (auto & pondered : _pondered) {
+      if (pondered.complete) ++toret.searched;
+      if (!(pondered.board == actual) || !pondered.started) continue;
+
+      toret.complete = pondered.complete;
+      toret.result = pondered.result;
+      if (tt && _tables[pondered.thread]) {
+        std::swap(tt, _tables[pondered.thread]);
+        toret.started = true;
+      }
+    }
+    return toret;
+  }
+};
+
+struct GameResult {
+  // the board the game ended on
+  Board board;
+  unsigned moves;
+  unsigned long long nodes;
+  // how long the search for each move took
+  std::vector<std::chrono::microseconds> move_times;
+};
+
+#ifdef THREES_SEARCH_STATS
+
+// a line of JSON about one search. nodes_by_depth counts from the
+// leaves up, the rates are out of the player's expanded nodes and
+// the swipes searched, ebf is the effective branching factor.
+// only the calling thread's hardware counters are read so a
+// parallel search shows just the main thread's part of it
+static
+void
+print_search_stats(std::ostream & out, unsigned move, const SearchResult & res,
+                   const SearchStats & stats, const TableStats & tt_stats,
+                   const uint64_t (*perf)[3]) {
+  auto rate = [] (unsigned long long n, unsigned long long d) {
+    return d ? double(n) / d : 0.0;
+  };
+  std::ostringstream line;
+  line << "{\"move\": " << move << ", \"depth\": " << res.depth << ", \"nodes\": " << res.nodes
+       << ", \"ms\": " << res.elapsed.count() / 1000.0 << ", \"nodes_by_depth\": [";
+  for (unsigned d = 0; d <= res.depth && d <= MAX_SEARCH_DEPTH; ++d) {
+    line << (d ? ", " : "") << stats.nodes[d];
+  }
+  line << "], \"leaves\": " << stats.nodes[0]
+       << ", \"beta_cutoff_rate\": " << rate(stats.beta_cutoffs, stats.expanded)
+       << ", \"refutation_rate\": " << rate(stats.refutations, stats.swipes)
+       << ", \"first_reply_refutation_rate\": "
+       << rate(stats.first_reply_refutations, stats.refutations)
+       << ", \"ebf\": " << (res.depth ? std::pow(double(res.nodes), 1.0 / res.depth) : 0.0)
+       << ", \"iterations\": [";
+  bool first = true;
+  for (unsigned d = 0; d <= MAX_SEARCH_DEPTH; ++d) {
+    if (!stats.iteration_nodes[d]) continue;
+    line << (first ? "" : ", ") << "{\"depth\": " << d << ", \"nodes\": " << stats.iteration_nodes[d]
+         << ", \"ms\": " << stats.iteration_ms[d] << "}";
+    first = false;
+  }
+  line << "], \"tt\": {\"probes\": " << tt_stats.probes << ", \"hits\": " << tt_stats.hits
+       << ", \"cutoffs\": " << tt_stats.cutoffs << "}, \"perf\": ";
+  if (perf) {
+    line << "{\"cycles\": " << (*perf)[0] << ", \"instructions\": " << (*perf)[1]
+         << ", \"cache_misses\": " << (*perf)[2] << "}";
+  }
+  else line << "null";
+  line << "}\n";
+
+  // self-play games share the stream
+  static std::mutex lock;
+  std::lock_guard<std::mutex> guard(lock);
+  out << line.str() << std::flush;
+}
+
+#endif
+
+// plays until there's no move left
+template<class GameIO>
+GameResult
+run_game(Board board, GameIO gio, const SolverOptions & options) {
+  std::unique_ptr<TranspositionTable> tt;
+  if (options.tt_size) tt.reset(new TranspositionTable(options.tt_size));
+  std::unique_ptr<ParallelSearch> parallel;
+  std::unique_ptr<LazySmpSearch> lazy_smp;
+  if (options.threads > 1 && options.parallel == ParallelMode::ROOT) {
+    parallel.reset(new ParallelSearch(options.threads, options.tt_size));
+  }
+  if (options.threads > 1 && options.parallel == ParallelMode::LAZY_SMP) {
+    lazy_smp.reset(new LazySmpSearch(options.threads, options.tt_size));
+  }
+  std::unique_ptr<Ponderer> ponderer;
+  if (options.ponder) ponderer.reset(new Ponderer(options));
+  Ponderer::Outcome pondered = {false, false, {}, 0, 0};
+  SEARCH_STATS(PerfCounters perf;)
+
+  GameResult toret = {board, 0, 0, {}};
+  while (true) {
+    gio.current_board(board);
+
+    if (game_is_over(board)) {
+      toret.board = board;
+      return toret;
+    }
+
+    // a table handed over by the ponderer already holds this position
+    if (pondered.started && !parallel && !lazy_smp) {
+      if (options.reuse_tree) tt->next_generation();
+    }
+    else if (options.reuse_tree) {
+      if (tt) tt->next_generation();
+      if (parallel) parallel->next_generation();
+      if (lazy_smp) lazy_smp->next_generation();
+    }
+    else {
+      if (tt) tt->clear();
+      if (parallel) parallel->clear();
+      if (lazy_smp) lazy_smp->clear();
+    }
+    SearchContext ctx = {tt.get()};
+    ctx.ordering = options.ordering;
+    ctx.symmetry = options.symmetry;
+    ctx.deeper_cutoffs = options.reuse_tree;
+    ctx.batch_leaves = options.batch_leaves;
+    ctx.selectivity = options.selectivity;
+    ctx.driver = options.driver;
+    SEARCH_STATS(if (options.search_stats) perf.start();)
+    auto res = (pondered.complete
+                ? pondered.result
+                : options.engine == SearchEngine::EXPECTIMAX
+                ? search_position_expectimax(BoundedTableEvaluator(), ctx, board,
+                                             options.limits, options.chance)
+                : lazy_smp
+                ? lazy_smp->search(table_board_evaluator, ctx, board, options.limits)
+                : parallel
+                ? search_position_parallel(table_board_evaluator, ctx, *parallel, board,
+                                           options.limits, options.split)
+                : search_position(table_board_evaluator, ctx, board, options.limits));
+    if (res.death_guaranteed) {
+      gio.log() << "Death is unavoidable at this point" << std::endl;
+    }
+    ++toret.moves;
+    toret.nodes += res.nodes;
+    toret.move_times.push_back(res.elapsed);
+    auto tt_stats = (lazy_smp ? lazy_smp->tt_stats() :
+                     parallel ? parallel->tt_stats() :
+                     ctx.tt_stats);
+    if (options.print_search_info) {
+      gio.log() << "searched to depth " << res.depth << ": " << res.nodes << " nodes in "
+                << res.elapsed.count() / 1000.0 << " ms, " << res.collapsed_leaves
+                << " leaves collapsed";
+      if (options.reuse_tree) {
+        gio.log() << ", reuse saved ~" << tt_stats.reused_nodes << " nodes";
+      }
+      if (ponderer) {
+        gio.log() << (pondered.complete ? ", answered by pondering" :
+                      pondered.started ? ", continued from pondering" : ", not pondered")
+                  << " (" << pondered.searched << "/" << pondered.positions << " positions)";
+      }
+      gio.log() << std::endl;
+    }
+    if (options.print_tt_stats && options.tt_size) tt_stats.print(gio.log());
+    SEARCH_STATS(if (options.search_stats) {
+        uint64_t counts[3];
+        print_search_stats(*options.search_stats, toret.moves, res, ctx.stats, tt_stats,
+                           perf.stop(counts) ? &counts : nullptr);
+      })
+
+    auto player_move = res.best_move;
+
+    board.shift(player_move);
+    if (ponderer) ponderer->start(board, player_move);
+
+    bool error = false;
+    while (true) {
+      auto cr = gio.get_computers_response(board, player_move, error);
+
+      try {
+        board.computers_move(player_move, cr.card_placement, cr.next_color);
+      }
+      catch (...) {
+        error = true;
+        continue;
+      }
+
+      break;
+    }
+    if (ponderer) pondered = ponderer->finish(board, tt);
+  }
+}
+
+// what the game shows at the end: a 3 is worth 3 points and
+// every doubling after that triples it, 1s and 2s are worth nothing
+static
+unsigned long long
+game_score(const Board & board) {
+  unsigned long long toret = 0;
+  for (size_t y = 0; y < Board::BOARD_SIZE; ++y) {
+    for (size_t x = 0; x < Board::BOARD_SIZE; ++x) {
+      auto value = board[{x, y}].value();
+      if (value < 3) continue;
+      unsigned long long points = 3;
+      for (; value > 3; value /= 2) points *= 3;
+      toret += points;
+    }
+  }
+  return toret;
+}
+
+// how the game starts: 9 of the first 12 cards dealt on random cells,
+// the next one is the next color
+static
+Board
+random_opening(std::mt19937 & rng) {
+  Card cards[] = {1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3};
+  std::shuffle(std::begin(cards), std::end(cards), rng);
+  size_t cells[Board::BOARD_ELTS];
+  std::iota(std::begin(cells), std::end(cells), 0);
+  std::shuffle(std::begin(cells), std::end(cells), rng);
+
+  std::vector<CardPlacement> init;
+  for (size_t i = 0; i < 9; ++i) {
+    init.push_back({cards[i], {cells[i] % Board::BOARD_SIZE, cells[i] / Board::BOARD_SIZE}});
+  }
+  auto next = cards[9].value();
+  return Board(init, next == 1 ? NextColor::BLUE : next == 2 ? NextColor::RED : NextColor::WHITE);
+}
+
+enum class StatsFormat {
+  TEXT,
+  // one row per game
+  CSV,
+  // the summary and every game
+  JSON,
+};
+
+// `s` as a JSON string, quotes included
+static
+std::string
+json_string(const std::string & s) {
+  std::ostringstream toret;
+  toret << '"';
+  for (unsigned char c : s) {
+    if (c == '"' || c == '\\') toret << '\\' << c;
+    else if (c < 0x20) {
+      toret << "\\u" << std::hex << std::setw(4) << std::setfill('0') << unsigned(c);
+    }
+    else toret << c;
+  }
+  toret << '"';
+  return toret.str();
+}
+
+// `s` as a CSV field, quoted if it has to be
+static
+std::string
+csv_field(const std::string & s) {
+  if (s.find_first_of(",\"\r\n") == std::string::npos) return s;
+  std::string toret = "\"";
+  for (auto c : s) {
+    if (c == '"') toret += '"';
+    toret += c;
+  }
+  return toret + "\"";
+}
+
+// the p-th percentile of `sorted`, nearest rank
+template <class T>
+static
+T
+percentile(const std::vector<T> & sorted, unsigned p) {
+  assert(!sorted.empty());
+  return sorted[(sorted.size() - 1) * p / 100];
+}
+
+// plays `games` games from random openings, `jobs` at a time, and
+// reports how fast and how well they went. game i is seeded from
+// `seed` and i alone so any game can be played again on its own
+static
+void
+run_self_play(const SolverOptions & options, unsigned games, unsigned jobs,
+              unsigned long long seed, bool track_deck, StatsFormat format) {
+  struct Played {
+    unsigned seed;
+    GameResult result;
+    std::chrono::microseconds elapsed;
+  };
+  const Played unplayed = {0, {Board(std::vector<CardPlacement>(), NextColor::BLUE), 0, 0, {}}, {}};
+  std::vector<Played> played(games, unplayed);
+  std::mutex error_mutex;
+  std::string error;
+
+  auto start = SearchContext::clock::now();
+  {
+    ThreadPool pool(jobs);
+    for (unsigned game = 0; game < games; ++game) {
+      pool.submit([&, game] (unsigned) {
+          auto & p = played[game];
+          p.seed = unsigned(splitmix64(seed + game));
+          try {
+            std::mt19937 rng(p.seed);
+            auto board = random_opening(rng);
+            if (track_deck) board.set_deck(starting_deck(board));
+            auto game_start = SearchContext::clock::now();
+            p.result = run_game(board, SelfPlayGameIO(rng()), options);
+            p.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+              SearchContext::clock::now() - game_start);
+          }
+          catch (const std::exception & e) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            error = e.what();
+          }
+        });
+    }
+    pool.wait();
+  }
+  if (!error.empty()) throw std::runtime_error(error);
+  auto seconds = std::chrono::duration<double>(SearchContext::clock::now() - start).count();
+
+  unsigned long long moves = 0, nodes = 0;
+  std::vector<double> move_ms;
+  std::vector<unsigned long long> scores;
+  std::map<unsigned, unsigned> max_cards;
+  for (const auto & p : played) {
+    moves += p.result.moves;
+    nodes += p.result.nodes;
+    for (auto t : p.result.move_times) move_ms.push_back(t.count() / 1000.0);
+    scores.push_back(game_score(p.result.board));
+    ++max_cards[p.result.board.max_card().value()];
+  }
+  std::sort(move_ms.begin(), move_ms.end());
+  std::sort(scores.begin(), scores.end());
+  if (move_ms.empty()) move_ms.push_back(0);
+  if (scores.empty()) scores.push_back(0);
+  auto mean_score = std::accumulate(scores.begin(), scores.end(), 0.0) / scores.size();
+
+  auto & out = std::cout;
+  out << std::fixed << std::setprecision(3);
+  switch (format) {
+  case StatsFormat::TEXT: {
+    out << games << " games, " << moves << " moves in " << seconds << " s: "
+        << games / seconds << " games/s, " << moves / seconds << " moves/s, "
+        << nodes / seconds << " nodes/s" << std::endl
+        << "move ms: p50 " << percentile(move_ms, 50) << ", p99 " << percentile(move_ms, 99)
+        << ", max " << move_ms.back() << std::endl
+        << "score: mean " << mean_score << ", p50 " << percentile(scores, 50)
+        << ", min " << scores.front() << ", max " << scores.back() << std::endl
+        << "max card:";
+    for (const auto & mc : max_cards) out << " " << mc.first << " x" << mc.second;
+    out << std::endl;
+    break;
+  }
+  case StatsFormat::CSV: {
+    out << "game,seed,moves,nodes,ms,score,max_card" << std::endl;
+    for (size_t i = 0; i < played.size(); ++i) {
+      const auto & p = played[i];
+      out << i << "," << p.seed << "," << p.result.moves << "," << p.result.nodes << ","
+          << p.elapsed.count() / 1000.0 << "," << game_score(p.result.board) << ","
+          << p.result.board.max_card().value() << std::endl;
+    }
+    break;
+  }
+  case StatsFormat::JSON: {
+    out << "{\"games\": " << games << ", \"moves\": " << moves << ", \"nodes\": " << nodes
+        << ", \"seconds\": " << seconds
+        << ", \"games_per_second\": " << games / seconds
+        << ", \"moves_per_second\": " << moves / seconds
+        << ", \"nodes_per_second\": " << nodes / seconds
+        << ",\n \"move_ms\": {\"p50\": " << percentile(move_ms, 50)
+        << ", \"p99\": " << percentile(move_ms, 99) << ", \"max\": " << move_ms.back() << "}"
+        << ",\n \"score\": {\"mean\": " << mean_score << ", \"p50\": " << percentile(scores, 50)
+        << ", \"min\": " << scores.front() << ", \"max\": " << scores.back() << "}"
+        << ",\n \"max_cards\": {";
+    for (auto it = max_cards.begin(); it != max_cards.end(); ++it) {
+      out << (it == max_cards.begin() ? "" : ", ") << "\"" << it->first << "\": " << it->second;
+    }
+    out << "},\n \"per_game\": [";
+    for (size_t i = 0; i < played.size(); ++i) {
+      const auto & p = played[i];
+      out << (i ? ",\n  " : "\n  ") << "{\"seed\": " << p.seed << ", \"moves\": " << p.result.moves
+          << ", \"nodes\": " << p.result.nodes << ", \"ms\": " << p.elapsed.count() / 1000.0
+          << ", \"score\": " << game_score(p.result.board)
+          << ", \"max_card\": " << p.result.board.max_card().value() << "}";
+    }
+    out << "]}" << std::endl;
+    break;
+  }
+  }
+  out.unsetf(std::ios_base::floatfield);
+}
+
+// analyzes every board in `in`, one per line in the same format as
+// the solver's input with blank lines and # comments skipped, `jobs`
+// at a time. only a bounded number of boards are read ahead of the
+// oldest one not written yet so the input can be any size, results
+// come out in input order. every job keeps its table from one board
+// to the next unless --no-reuse, which makes each result independent
+// of the boards that job analyzed before
+static
+void
+run_batch(const SolverOptions & options, std::istream & in, unsigned jobs,
+          bool track_deck, StatsFormat format) {
+  struct Analysis {
+    unsigned long long line;
+    std::string text;
+    SearchResult result;
+    std::string error;
+    bool done;
+  };
+  // the main thread is the only one adding and removing boards, jobs
+  // only touch their own, which stays put as the deque changes at
+  // either end
+  std::deque<Analysis> pending;
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::vector<std::unique_ptr<TranspositionTable>> tables(jobs);
+  const size_t read_ahead = size_t(jobs) * 16;
+
+  auto analyze = [&] (Analysis & a, unsigned thread) {
+    try {
+      std::istringstream ls(a.text);
+      auto board = read_board_from_human_input(ls);
+      if (track_deck) board.set_deck(starting_deck(board));
+
+      auto & tt = tables[thread];
+      if (!tt && options.tt_size) tt.reset(new TranspositionTable(options.tt_size));
+      if (tt && options.reuse_tree) tt->next_generation();
+      else if (tt) tt->clear();
+      SearchContext ctx = {tt.get()};
+      ctx.ordering = options.ordering;
+      ctx.symmetry = options.symmetry;
+      ctx.deeper_cutoffs = options.reuse_tree;
+      ctx.batch_leaves = options.batch_leaves;
+      ctx.selectivity = options.selectivity;
+      ctx.driver = options.driver;
+      a.result = (options.engine == SearchEngine::EXPECTIMAX
+                  ? search_position_expectimax(BoundedTableEvaluator(), ctx, board,
+                                               options.limits, options.chance)
+                  : search_position(table_board_evaluator, ctx, board, options.limits));
+    }
+    catch (const std::exception & e) {
+      a.error = e.what();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    a.done = true;
+    finished.notify_all();
+  };
+
+  auto & out = std::cout;
+  out << std::fixed << std::setprecision(3);
+  if (format == StatsFormat::CSV) {
+    out << "line,move,score,death_guaranteed,depth,nodes,ms,error" << std::endl;
+  }
+  auto write_oldest = [&] () {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      finished.wait(lock, [&] { return pending.front().done; });
+    }
+    const auto & a = pending.front();
+    const auto & r = a.result;
+    switch (format) {
+    case StatsFormat::TEXT:
+      out << "line " << a.line << ": ";
+      if (!a.error.empty()) out << "error: " << a.error;
+      else {
+        out << r.best_move << ", score " << r.score << ", depth " << r.depth;
+        if (r.death_guaranteed) out << ", death is unavoidable";
+      }
+      break;
+    case StatsFormat::CSV:
+      out << a.line << ",";
+      if (!a.error.empty()) out << ",,,,,," << csv_field(a.error);
+      else {
+        out << r.best_move << "," << r.score << "," << r.death_guaranteed << "," << r.depth << ","
+            << r.nodes << "," << r.elapsed.count() / 1000.0 << ",";
+      }
+      break;
+    case StatsFormat::JSON:
+      // a line each so the output streams too
+      out << "{\"line\": " << a.line;
+      if (!a.error.empty()) out << ", \"error\": " << json_string(a.error);
+      else {
+        out << ", \"move\": " << json_string(to_string(r.best_move)) << ", \"score\": " << r.score
+            << ", \"death_guaranteed\": " << (r.death_guaranteed ? "true" : "false")
+            << ", \"depth\": " << r.depth << ", \"nodes\": " << r.nodes
+            << ", \"ms\": " << r.elapsed.count() / 1000.0;
+      }
+      out << "}";
+      break;
+    }
+    out << "\n";
+    pending.pop_front();
+  };
+
+  {
+    ThreadPool pool(jobs);
+    std::string text;
+    unsigned long long line = 0;
+    while (std::getline(in, text)) {
+      ++line;
+      if (strip_string(text).empty() || text[0] == '#') continue;
+      if (pending.size() >= read_ahead) write_oldest();
+      pending.push_back({line, text, {}, {}, false});
+      auto a = &pending.back();
+      pool.submit([&, a] (unsigned thread) { analyze(*a, thread); });
+    }
+    while (!pending.empty()) write_oldest();
+  }
+  out << std::flush;
+  out.unsetf(std::ios_base::floatfield);
+}
+
+static
+bool
+bitboard_matches_board(const BitBoard & bitboard, const Board & board) {
+  if (bitboard.next_color() != board.next_color()) return false;
+  if (bitboard.max_card() != board.max_card()) return false;
+  if (compute_board_friction(bitboard) != compute_board_friction(board)) return false;
+  for (size_t y = 0; y < Board::BOARD_SIZE; ++y) {
+    for (size_t x = 0; x < Board::BOARD_SIZE; ++x) {
+      if (bitboard[{x, y}] != board[{x, y}]) return false;
+    }
+  }
+  return BitBoard(board) == bitboard;
+}
+
+// plays random games on both a Board and a BitBoard in lockstep
+// and checks that they never disagree
+static
+bool
+check_bitboard(unsigned games, unsigned seed) {
+  std::mt19937 rng(seed);
+  const NextColor colors[] = {NextColor::RED, NextColor::BLUE, NextColor::WHITE};
+  const PlayerMove moves[] = {
+    PlayerMove::SWIPE_UP,
+    PlayerMove::SWIPE_DOWN,
+    PlayerMove::SWIPE_LEFT,
+    PlayerMove::SWIPE_RIGHT,
+  };
+
+  unsigned long long positions = 0;
+  for (unsigned game = 0; game < games; ++game) {
+    // alternate between realistic openings and boards with
+    // arbitrary cards so the high ranks get exercised too
+    std::vector<CardPlacement> init;
+    auto max_rank = game % 2 ? 14 : 3;
+    for (size_t y = 0; y < Board::BOARD_SIZE; ++y) {
+      for (size_t x = 0; x < Board::BOARD_SIZE; ++x) {
+        if (rng() % 2) continue;
+        auto rank = 1 + rng() % max_rank;
+        init.push_back({BitBoard::rank_to_card(rank), {x, y}});
+      }
+    }
+
+    Board board(init, colors[rng() % 3]);
+    BitBoard bitboard(board);
+
+    while (true) {
+      ++positions;
+      if (!bitboard_matches_board(bitboard, board) ||
+          !bitboard_matches_board(BitBoard(bitboard.to_board()), board)) {
+        std::cout << "bitboard mismatch in game " << game << ":" << std::endl;
+        board.print_board(std::cout);
+        std::cout << "vs" << std::endl;
+        bitboard.to_board().print_board(std::cout);
+        return false;
+      }
+
+      std::vector<PlayerMove> legal_moves;
+      for (auto move : moves) {
+        if (board.can_shift(move) != bitboard.can_shift(move)) {
+          std::cout << "can_shift(" << move << ") mismatch in game " << game << ":" << std::endl;
+          board.print_board(std::cout);
+          return false;
+        }
+        if (board.can_shift(move)) legal_moves.push_back(move);
+      }
+
+      // two 12288s can't be merged in a BitBoard, don't go there
+      if (legal_moves.empty() || bitboard.max_rank() == BitBoard::MAX_RANK) break;
+
+      auto move = legal_moves[rng() % legal_moves.size()];
+      board.shift(move);
+      bitboard.shift(move);
+      if (!bitboard_matches_board(bitboard, board)) {
+        std::cout << "shift(" << move << ") mismatch in game " << game << ":" << std::endl;
+        board.print_board(std::cout);
+        std::cout << "vs" << std::endl;
+        bitboard.to_board().print_board(std::cout);
+        return false;
+      }
+
+      auto placements = possible_computer_card_placements_post_shift(board, move);
+      auto cp = placements[rng() % placements.size()];
+      auto nc = colors[rng() % 3];
+      board.computers_move(move, cp, nc);
+      bitboard.computers_move(move, cp, nc);
+    }
+  }
+
+  std::cout << "bitboard agrees with board on " << positions
+            << " positions over " << games << " games" << std::endl;
+  return true;
+}
+
+// positions seen while playing random moves from random openings,
+// every other opening has arbitrary cards up to 6144 so that the
+// corpus isn't all small cards
+static
+std::vector<Board>
+random_game_boards(unsigned count, unsigned seed) {
+  std::mt19937 rng(seed);
+  const NextColor colors[] = {NextColor::RED, NextColor::BLUE, NextColor::WHITE};
+
+  std::vector<Board> toret;
+  for (unsigned game = 0; toret.size() < count; ++game) {
+    std::vector<CardPlacement> init;
+    auto max_rank = game % 2 ? 14 : 3;
+    for (size_t y = 0; y < Board::BOARD_SIZE; ++y) {
+      for (size_t x = 0; x < Board::BOARD_SIZE; ++x) {
+        if (rng() % 2) init.push_back({BitBoard::rank_to_card(1 + rng() % max_rank), {x, y}});
+      }
+    }
+
+    Board board(init, colors[rng() % 3]);
+    // stop before anything a BitBoard can't hold shows up
+    const auto max_card = BitBoard::rank_to_card(BitBoard::MAX_RANK).value();
+    while (toret.size() < count && !game_is_over(board) &&
+           board.max_card().value() < max_card) {
+      toret.push_back(board);
+
+      PlayerMove move;
+      do {
+        move = static_cast<PlayerMove>(1 + rng() % 4);
+      } while (!board.can_shift(move));
+
+      board.shift(move);
+      auto placements = possible_computer_card_placements_post_shift(board, move);
+      board.computers_move(move, placements[rng() % placements.size()], colors[rng() % 3]);
+    }
+  }
+
+  return toret;
+}
+
+// checks that table_board_evaluator() orders boards exactly like
+// board_evaluator() does
+static
+bool
+check_evaluator(unsigned count, unsigned seed) {
+  struct Scored {
+    reference_score_t reference;
+    board_score_t score;
+  };
+
+  auto kernels = available_friction_kernels();
+
+  std::vector<Scored> scored;
+  // consecutive boards are mostly a swipe and a placement apart
+  BoardFeatures incremental(BitBoard(0, NextColor::BLUE));
+  for (const auto & board : random_game_boards(count, seed)) {
+    BitBoard bitboard(board);
+    for (const auto & kernel : kernels) {
+      if (compute_board_friction(board) != kernel.friction(bitboard)) {
+        std::cout << kernel.name << " friction mismatch on board:" << std::endl;
+        board.print_board(std::cout);
+        return false;
+      }
+    }
+    auto features = leaf_features(bitboard);
+    if (features.can_move == game_is_over(bitboard) ||
+        features.max_rank != bitboard.max_rank() ||
+        features.friction != compute_board_friction(bitboard) ||
+        table_board_evaluator(features) != table_board_evaluator(bitboard)) {
+      std::cout << "leaf features mismatch on board:" << std::endl;
+      board.print_board(std::cout);
+      return false;
+    }
+    incremental.update(bitboard);
+    if (!same_features(incremental.features(), features)) {
+      std::cout << "incremental features mismatch on board:" << std::endl;
+      board.print_board(std::cout);
+      return false;
+    }
+    scored.push_back({board_evaluator(board), table_board_evaluator(bitboard)});
+  }
+
+  // the corpus stops short of lost games, so check mobility
+  // on full boards as well, plenty of which can't move
+  std::mt19937_64 rng(seed);
+  unsigned stuck = 0;
+  for (unsigned i = 0; i < count; ++i) {
+    BitBoard::cells_type cells = 0;
+    for (size_t j = 0; j < Board::BOARD_SIZE * Board::BOARD_SIZE; ++j) {
+      cells |= BitBoard::cells_type(1 + rng() % 5) << (j * 4);
+    }
+    BitBoard full(cells, NextColor::BLUE);
+    if (leaf_features(full).can_move == game_is_over(full)) {
+      std::cout << "leaf mobility mismatch on board:" << std::endl;
+      full.to_board().print_board(std::cout);
+      return false;
+    }
+    stuck += game_is_over(full);
+  }
+
+  std::sort(scored.begin(), scored.end(), [] (const Scored & a, const Scored & b) {
+      return a.reference < b.reference;
+    });
+
+  size_t distinct = 1;
+  for (size_t i = 1; i < scored.size(); ++i) {
+    const auto & a = scored[i - 1];
+    const auto & b = scored[i];
+    auto same_order = (a.reference == b.reference
+                       ? a.score == b.score
+                       : a.score < b.score);
+    if (!same_order) {
+      std::cout << "evaluator order mismatch: " <<
+        a.reference << " vs " << b.reference << " became " <<
+        a.score << " vs " << b.score << std::endl;
+      return false;
+    }
+    if (a.reference != b.reference) ++distinct;
+  }
+
+  std::cout << "table evaluator agrees with board_evaluator on " << scored.size()
+            << " boards (" << distinct << " distinct scores)" << std::endl;
+  std::cout << "leaf features agree on those and " << count << " full boards ("
+            << stuck << " without a move)" << std::endl;
+  std::cout << "friction kernels checked:";
+  for (const auto & kernel : kernels) std::cout << " " << kernel.name;
+  std::cout << " (using " << best_friction_kernel.name << ")" << std::endl;
+  return true;
+}
+
+// checks that transforming a board transforms its swipes and keeps
+// its score and canonical form, and that searching with symmetry
+// picks the same moves as searching without it
+static
+bool
+check_symmetry(unsigned count, unsigned seed) {
+  auto boards = random_game_boards(count, seed);
+  unsigned long long searches = 0;
+  for (size_t i = 0; i < boards.size(); ++i) {
+    BitBoard board(boards[i]);
+    auto cells = board.raw_cells();
+    auto canonical = canonicalize(cells);
+
+    for (Transform t = 0; t < TRANSFORM_COUNT; ++t) {
+      BitBoard transformed(transform_cells(cells, t), board.next_color());
+      auto fail = [&] (const std::string & what) {
+        std::cout << what << " mismatch under transform " << t << " on board:" << std::endl;
+        boards[i].print_board(std::cout);
+        return false;
+      };
+
+      if (transform_cells(transformed.raw_cells(), inverse_transform(t)) != cells) return fail("inverse");
+      if (table_board_evaluator(transformed) != table_board_evaluator(board)) return fail("score");
+      if (canonicalize(transformed.raw_cells()).cells != canonical.cells) return fail("canonical board");
+      if (((canonical.symmetries >> t) & 1) != (transformed == board)) return fail("symmetries");
+
+      for (auto move : {
+             PlayerMove::SWIPE_UP,
+             PlayerMove::SWIPE_DOWN,
+             PlayerMove::SWIPE_LEFT,
+             PlayerMove::SWIPE_RIGHT}) {
+        auto a = board.shifted(move);
+        auto b = transformed.shifted(transform_move(move, t));
+        if (a.moved != b.moved || transform_cells(a.cells, t) != b.cells) {
+          return fail("swipe " + to_string(move));
+        }
+      }
+    }
+
+    // searching is slow, only do some of them
+    if (i % 64) continue;
+    ++searches;
+    SearchResult results[2];
+    for (bool symmetry : {false, true}) {
+      TranspositionTable tt(14);
+      SearchContext ctx = {&tt};
+      ctx.symmetry = symmetry;
+      results[symmetry] = search_position(table_board_evaluator, ctx, boards[i],
+                                          {3, std::chrono::milliseconds(0), 0});
+    }
+    if (results[0].best_move != results[1].best_move || results[0].score != results[1].score) {
+      std::cout << "search with symmetry disagrees on board:" << std::endl;
+      boards[i].print_board(std::cout);
+      return false;
+    }
+  }
+
+  std::cout << "symmetries agree on " << boards.size() << " boards, "
+            << searches << " searches agree with and without symmetry" << std::endl;
+  return true;
+}
+
+#ifdef THREES_COUNT_ALLOCATIONS
+
+// every allocation made through operator new, which is where the
+// standard containers get their memory from. only built with
+// THREES_COUNT_ALLOCATIONS, counting them isn't free
+static std::atomic<unsigned long long> allocations(0);
+
+// kept out of line, gcc warns about malloc() and free() meeting new
+// and delete when it inlines them into the same function
+__attribute__((noinline))
+void *
+operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline))
+void
+operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void
+operator delete(void *p, std::size_t) noexcept {
+  operator delete(p);
+}
+
+// checks that search_position() on positions from a few games to
+// `depth` doesn't allocate once the table is there, with every
+// driver and with and without a deck
+static
+bool
+check_allocations(unsigned count, unsigned depth, unsigned seed) {
+  auto boards = random_game_boards(count * 16, seed);
+  TranspositionTable tt(16);
+  unsigned long long nodes = 0;
+  const struct {
+    const char *name;
+    SearchDriver driver;
+  } drivers[] = {
+    {"alphabeta", SearchDriver::ALPHABETA},
+    {"pvs", SearchDriver::PVS},
+    {"mtdf", SearchDriver::MTDF},
+  };
+  for (size_t i = 0; i < boards.size(); i += 16) {
+    for (const auto & driver : drivers) {
+      for (bool deck : {false, true}) {
+        auto board = boards[i];
+        if (deck) board.set_deck(starting_deck(board));
+        tt.clear();
+        SearchContext ctx = {&tt};
+        ctx.driver = driver.driver;
+        auto before = allocations.load();
+        auto res = search_position(table_board_evaluator, ctx, board,
+                                   {depth, std::chrono::milliseconds(0), 0});
+        auto allocated = allocations.load() - before;
+        nodes += res.nodes;
+        if (allocated) {
+          std::cout << "searching to depth " << depth << " with " << driver.name
+                    << (deck ? " and a deck" : "") << " allocated " << allocated
+                    << " times on board:" << std::endl;
+          board.print_board(std::cout);
+          return false;
+        }
+      }
+    }
+  }
+
+  std::cout << "no allocations in " << nodes << " nodes searched to depth "
+            << depth << std::endl;
+  return true;
+}
+
+#endif
+
+// plays a game with random computer's moves, searching every position
+// both from scratch and with the table kept from the position before,
+// and reports how much work keeping it saved
+static
+void
+compare_tree_reuse(unsigned moves, const SearchLimits & limits, unsigned seed) {
+  std::mt19937 rng(seed);
+  const NextColor colors[] = {NextColor::RED, NextColor::BLUE, NextColor::WHITE};
+  std::vector<CardPlacement> init = {
+    {BitBoard::rank_to_card(1), {0, 0}},
+    {BitBoard::rank_to_card(2), {1, 1}},
+    {BitBoard::rank_to_card(3), {2, 2}},
+  };
+  Board board(init, NextColor::BLUE);
+  const auto max_card = BitBoard::rank_to_card(BitBoard::MAX_RANK).value();
+
+  TranspositionTable fresh_tt(19), reuse_tt(19);
+  unsigned long long fresh_nodes = 0, reuse_nodes = 0, estimated = 0;
+  double fresh_ms = 0, reuse_ms = 0;
+  unsigned played = 0, same_move = 0;
+  for (; played < moves && !game_is_over(board) &&
+         board.max_card().value() < max_card; ++played) {
+    fresh_tt.clear();
+    SearchContext fresh = {&fresh_tt};
+    auto a = search_position(table_board_evaluator, fresh, board, limits);
+
+    reuse_tt.next_generation();
+    SearchContext reuse = {&reuse_tt};
+    reuse.deeper_cutoffs = true;
+    auto b = search_position(table_board_evaluator, reuse, board, limits);
+
+    fresh_nodes += a.nodes;
+    reuse_nodes += b.nodes;
+    fresh_ms += a.elapsed.count() / 1000.0;
+    reuse_ms += b.elapsed.count() / 1000.0;
+    estimated += reuse.tt_stats.reused_nodes;
+    if (a.best_move == b.best_move) ++same_move;
+
+    board.shift(a.best_move);
+    auto placements = possible_computer_card_placements_post_shift(board, a.best_move);
+    board.computers_move(a.best_move, placements[rng() % placements.size()], colors[rng() % 3]);
+  }
+
+  std::cout << played << " moves: " << fresh_nodes << " nodes in " << fresh_ms << " ms from scratch, "
+            << reuse_nodes << " nodes in " << reuse_ms << " ms reusing the table ("
+            << std::fixed << std::setprecision(1)
+            << (fresh_nodes ? 100.0 * (fresh_nodes - double(reuse_nodes)) / fresh_nodes : 0.0)
+            << "% fewer, estimated ~" << (played ? estimated / played : 0) << " per move), "
+            << (played ? 100.0 * same_move / played : 0.0) << "% same move" << std::endl;
+  std::cout.unsetf(std::ios_base::floatfield);
+}
 
-  serialized << next_color_to_human_string(board_p->next_color()) << " ";
+struct SearchVariant {
+  std::string name;
+  std::function<SearchResult (const Board &)> search;
+};
 
-  for (size_t y = 0; y < Board::BOARD_SIZE; ++y) {
-    for (size_t x = 0; x < Board::BOARD_SIZE; ++x) {
-      serialized << (*board_p)[{x, y}].value() << " ";
+// runs every variant over the same boards and reports how much work
+// each did and how often it agreed with the first one
+static
+void
+compare_search_variants(const std::vector<Board> & boards,
+                        const std::vector<SearchVariant> & variants) {
+  std::vector<SearchResult> baseline;
+  double baseline_ms = 0;
+  std::cout << std::left << std::setw(16) << "variant" << std::right
+            << std::setw(14) << "nodes" << std::setw(12) << "ms"
+            << std::setw(14) << "nodes/s" << std::setw(10) << "speedup"
+            << std::setw(12) << "same move"
+            << std::setw(12) << "same score" << std::endl;
+
+  for (const auto & variant : variants) {
+    unsigned long long nodes = 0;
+    double ms = 0;
+    size_t same_move = 0, same_score = 0;
+    for (size_t i = 0; i < boards.size(); ++i) {
+      auto res = variant.search(boards[i]);
+      nodes += res.nodes;
+      ms += res.elapsed.count() / 1000.0;
+      if (baseline.size() < boards.size()) baseline.push_back(res);
+      if (res.best_move == baseline[i].best_move) ++same_move;
+      if (res.score == baseline[i].score) ++same_score;
     }
+    if (!baseline_ms) baseline_ms = ms;
+
+    std::cout << std::left << std::setw(16) << variant.name << std::right
+              << std::setw(14) << nodes
+              << std::setw(12) << std::fixed << std::setprecision(1) << ms
+              << std::setw(14) << std::setprecision(0) << (ms ? nodes / ms * 1000 : 0)
+              << std::setw(9) << std::setprecision(2) << (ms ? baseline_ms / ms : 0) << "x"
+              << std::setw(11) << std::setprecision(1) << 100.0 * same_move / boards.size() << "%"
+              << std::setw(11) << 100.0 * same_score / boards.size() << "%" << std::endl;
+    std::cout.unsetf(std::ios_base::floatfield);
   }
+}
 
-  auto ret_string = serialized.str();
-  auto to_copy = std::min(size, ret_string.size());
-  std::memmove(str, ret_string.data(), to_copy);
+// a spread of playable positions for comparing searches
+static
+std::vector<Board>
+search_corpus(unsigned count, unsigned seed) {
+  std::vector<Board> toret;
+  auto boards = random_game_boards(count * 16, seed);
+  for (size_t i = 0; i < boards.size() && toret.size() < count; i += 16) {
+    if (!game_is_over(boards[i])) toret.push_back(boards[i]);
+  }
+  return toret;
+}
 
-  return to_copy;
+static
+SearchVariant
+expectimax_variant(std::string name, unsigned depth, ChanceModel model) {
+  return {name, [=] (const Board & board) {
+      SearchContext ctx = {nullptr};
+      return search_position_expectimax(BoundedTableEvaluator(), ctx, board,
+                                        {depth, std::chrono::milliseconds(0), 0}, model);
+    }};
 }
 
-void
-free_board(void *b) {
-  delete [] (char *) b;
+static
+SearchVariant
+deck_variant(std::string name, unsigned depth) {
+  return {name, [=] (const Board & board) {
+      auto dealt = board;
+      dealt.set_deck(starting_deck(board));
+      TranspositionTable tt(16);
+      SearchContext ctx = {&tt};
+      return search_position(table_board_evaluator, ctx, dealt,
+                             {depth, std::chrono::milliseconds(0), 0});
+    }};
 }
 
-worker_handle
-create_worker(const char *url) {
-  return emscripten_create_worker(url);
+static
+SearchVariant
+fixed_depth_variant(std::string name, unsigned depth, MoveOrdering ordering) {
+  return {name, [=] (const Board & board) {
+      TranspositionTable tt(16);
+      SearchContext ctx = {&tt};
+      ctx.ordering = ordering;
+      return search_position(table_board_evaluator, ctx, board,
+                             {depth, std::chrono::milliseconds(0), 0});
+    }};
 }
 
-typedef void (*my_cb_t)(const char *);
+static
+SearchVariant
+selective_variant(std::string name, unsigned depth, Selectivity selectivity) {
+  return {name, [=] (const Board & board) {
+      TranspositionTable tt(16);
+      SearchContext ctx = {&tt};
+      ctx.selectivity = selectivity;
+      return search_position(table_board_evaluator, ctx, board,
+                             {depth, std::chrono::milliseconds(0), 0});
+    }};
+}
 
-void callback_js(char *data, int size, void *a) {
-  PlayerMove pm;
-  memcpy(&pm, data, size);
-  auto str_pm = to_string(pm);
-  auto cb = (my_cb_t) a;
-  cb(str_pm.c_str());
+// the table is only as big as the one the drivers make themselves
+static
+SearchVariant
+driver_variant(std::string name, unsigned depth, SearchDriver driver, bool table) {
+  return {name, [=] (const Board & board) {
+      std::unique_ptr<TranspositionTable> tt(table ? new TranspositionTable(DRIVER_CACHE_SIZE) : nullptr);
+      SearchContext ctx = {tt.get()};
+      ctx.driver = driver;
+      return search_position(table_board_evaluator, ctx, board,
+                             {depth, std::chrono::milliseconds(0), 0});
+    }};
 }
 
-void
-get_next_move(worker_handle wh, void *board, my_cb_t cb, unsigned level) {
-  char serialized_board[256];
-  std::memcpy(serialized_board, &level, sizeof(level));
-  auto actual_size = serialize_board(board, serialized_board + sizeof(level), sizeof(serialized_board) - sizeof(level));
-  emscripten_call_worker(wh, "web_worker",
-                         serialized_board, actual_size + sizeof(level),
-                         callback_js, (void *) cb);
+static
+SearchVariant
+parallel_variant(std::string name, unsigned depth, unsigned threads, RootSplit split) {
+  auto parallel = std::make_shared<ParallelSearch>(threads, 16);
+  return {name, [=] (const Board & board) {
+      parallel->clear();
+      SearchContext ctx = {nullptr};
+      return search_position_parallel(table_board_evaluator, ctx, *parallel, board,
+                                      {depth, std::chrono::milliseconds(0), 0}, split);
+    }};
 }
 
-PlayerMove
-player_move_from_string(std::string a) {
-  PlayerMove pm;
-  if (a == "SWIPE_UP") pm = PlayerMove::SWIPE_UP;
-  else if (a == "SWIPE_DOWN") pm = PlayerMove::SWIPE_DOWN;
-  else if (a == "SWIPE_LEFT") pm = PlayerMove::SWIPE_LEFT;
-  else if (a == "SWIPE_RIGHT") pm = PlayerMove::SWIPE_RIGHT;
-  else throw std::runtime_error("bad players move");
-  return pm;
+static
+SearchVariant
+lazy_smp_variant(std::string name, unsigned depth, unsigned threads) {
+  auto lazy_smp = std::make_shared<LazySmpSearch>(threads, 18);
+  return {name, [=] (const Board & board) {
+      lazy_smp->clear();
+      SearchContext like = {nullptr};
+      return lazy_smp->search(table_board_evaluator, like, board,
+                              {depth, std::chrono::milliseconds(0), 0});
+    }};
 }
 
-int
-make_computers_move(void *board,
-                    const char *players_move,
-                    unsigned card_value, size_t card_position_x, size_t card_position_y,
-                    const char *human_readable_next_color) {
-  auto board_p = (Board *) board;
-  try {
-    auto pm = player_move_from_string(players_move);
-    auto next_color = human_string_to_next_color(human_readable_next_color);
-    board_p->computers_move(pm, {card_value, {card_position_x, card_position_y}},
-                            next_color);
-    return true;
+#ifdef THREES_BENCH
+
+// keeps the compiler from throwing away what the kernels compute
+static volatile unsigned long long bench_sink;
+
+struct BenchResult {
+  std::string name;
+  // per repetition
+  std::vector<double> ns_per_op;
+  // searches only
+  unsigned long long nodes;
+  double seconds;
+};
+
+// one pass runs the kernel `ops` times over the corpus. passes are
+// doubled until one repetition takes at least `min_ms`, which also
+// warms up, and then `reps` repetitions are timed
+template <class Pass>
+static
+BenchResult
+bench_kernel(const std::string & name, size_t ops, unsigned reps, double min_ms, Pass pass) {
+  typedef std::chrono::steady_clock clock;
+  auto time_passes = [&] (unsigned long long passes) {
+    auto start = clock::now();
+    unsigned long long sink = 0;
+    for (unsigned long long i = 0; i < passes; ++i) sink += pass();
+    bench_sink = sink;
+    return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+  };
+
+  unsigned long long passes = 1;
+  while (time_passes(passes) < min_ms) passes *= 2;
+
+  BenchResult toret = {name, {}, 0, 0};
+  for (unsigned r = 0; r < reps; ++r) {
+    toret.ns_per_op.push_back(time_passes(passes) * 1e6 / (passes * ops));
   }
-  catch (...) {
-    return false;
+  std::sort(toret.ns_per_op.begin(), toret.ns_per_op.end());
+  return toret;
+}
+
+// reads one board per line in the same format as the solver's
+// input, skipping blank lines and # comments
+static
+std::vector<Board>
+read_bench_corpus(std::istream & is) {
+  std::vector<Board> toret;
+  std::string line;
+  while (std::getline(is, line)) {
+    if (strip_string(line).empty() || line[0] == '#') continue;
+    std::istringstream ls(line);
+    toret.push_back(read_board_from_human_input(ls));
   }
+  return toret;
 }
 
-int
-shift_board(void *board,
-            const char *players_move) {
-  auto board_p = (Board *) board;
-  try {
-    auto pm = player_move_from_string(players_move);
-    board_p->shift(pm);
-    return true;
+static
+void
+print_bench_results(const std::vector<BenchResult> & results, StatsFormat format) {
+  auto & out = std::cout;
+  out << std::fixed << std::setprecision(2);
+  auto mean = [] (const std::vector<double> & v) {
+    return std::accumulate(v.begin(), v.end(), 0.0) / v.size();
+  };
+  auto stddev = [&] (const std::vector<double> & v) {
+    auto m = mean(v);
+    double sum = 0;
+    for (auto x : v) sum += (x - m) * (x - m);
+    return std::sqrt(sum / v.size());
+  };
+
+  switch (format) {
+  case StatsFormat::TEXT: {
+    out << std::left << std::setw(26) << "kernel" << std::right
+        << std::setw(16) << "ns/op" << std::setw(16) << "min" << std::setw(16) << "max"
+        << std::setw(14) << "stddev" << std::setw(12) << "nodes/s" << std::endl;
+    for (const auto & r : results) {
+      out << std::left << std::setw(26) << r.name << std::right
+          << std::setw(16) << percentile(r.ns_per_op, 50)
+          << std::setw(16) << r.ns_per_op.front() << std::setw(16) << r.ns_per_op.back()
+          << std::setw(14) << stddev(r.ns_per_op) << std::setw(12);
+      if (r.seconds) out << std::setprecision(0) << r.nodes / r.seconds << std::setprecision(2);
+      else out << "-";
+      out << std::endl;
+    }
+    break;
   }
-  catch (...) {
-    return false;
+  case StatsFormat::CSV: {
+    out << "kernel,reps,median_ns,min_ns,max_ns,mean_ns,stddev_ns,nodes_per_second" << std::endl;
+    for (const auto & r : results) {
+      out << r.name << "," << r.ns_per_op.size() << "," << percentile(r.ns_per_op, 50) << ","
+          << r.ns_per_op.front() << "," << r.ns_per_op.back() << "," << mean(r.ns_per_op) << ","
+          << stddev(r.ns_per_op) << "," << (r.seconds ? r.nodes / r.seconds : 0) << std::endl;
+    }
+    break;
   }
+  case StatsFormat::JSON: {
+    out << "[";
+    for (size_t i = 0; i < results.size(); ++i) {
+      const auto & r = results[i];
+      out << (i ? ",\n " : "") << "{\"kernel\": " << json_string(r.name) << ", \"reps\": " << r.ns_per_op.size()
+          << ", \"median_ns\": " << percentile(r.ns_per_op, 50)
+          << ", \"min_ns\": " << r.ns_per_op.front() << ", \"max_ns\": " << r.ns_per_op.back()
+          << ", \"mean_ns\": " << mean(r.ns_per_op) << ", \"stddev_ns\": " << stddev(r.ns_per_op)
+          << ", \"nodes_per_second\": " << (r.seconds ? r.nodes / r.seconds : 0) << "}";
+    }
+    out << "]" << std::endl;
+    break;
+  }
+  }
+  out.unsetf(std::ios_base::floatfield);
 }
 
+// times the solver's kernels on a fixed corpus of boards, see
+// the bench target in the Makefile
+static
+int
+bench_main(int argc, char *argv[]) {
+  unsigned reps = 10;
+  unsigned depth = 4;
+  double min_ms = 20;
+  auto format = StatsFormat::TEXT;
+  std::string corpus_path = "bench-boards.txt";
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next_arg = [&] () -> std::string {
+      if (i + 1 >= argc) throw std::runtime_error("missing value for " + arg);
+      return argv[++i];
+    };
 
-}
+    if (arg == "--reps") reps = std::max(1ul, std::stoul(next_arg()));
+    else if (arg == "--depth") {
+      depth = std::stoul(next_arg());
+      if (depth > MAX_SEARCH_DEPTH) {
+        throw std::runtime_error("--depth can be at most " + std::to_string(MAX_SEARCH_DEPTH));
+      }
+    }
+    else if (arg == "--min-ms") min_ms = std::stod(next_arg());
+    else if (arg == "--stats") {
+      auto f = next_arg();
+      if (f == "text") format = StatsFormat::TEXT;
+      else if (f == "csv") format = StatsFormat::CSV;
+      else if (f == "json") format = StatsFormat::JSON;
+      else throw std::runtime_error("bad stats format: " + f);
+    }
+    else if (arg.compare(0, 2, "--")) corpus_path = arg;
+    else throw std::runtime_error("bad argument: " + arg);
+  }
 
-#else
+  std::ifstream corpus_file(corpus_path);
+  if (!corpus_file) throw std::runtime_error("can't open " + corpus_path);
+  auto boards = read_bench_corpus(corpus_file);
+  if (boards.empty()) throw std::runtime_error("no boards in " + corpus_path);
+  std::vector<BitBoard> bitboards(boards.begin(), boards.end());
+
+  const PlayerMove moves[] = {
+    PlayerMove::SWIPE_UP,
+    PlayerMove::SWIPE_DOWN,
+    PlayerMove::SWIPE_LEFT,
+    PlayerMove::SWIPE_RIGHT,
+  };
+  // every legal swipe of every board, and the board after it
+  struct Shifted {
+    Board before;
+    Board after;
+    PlayerMove move;
+  };
+  std::vector<Shifted> shifted;
+  for (const auto & board : boards) {
+    for (auto move : moves) {
+      if (!board.can_shift(move)) continue;
+      auto after = board;
+      after.shift(move);
+      shifted.push_back({board, after, move});
+    }
+  }
 
-class InvalidCardPlacementLine : public std::exception {};
-class FinishedEnteringCardPlacement : public std::exception {};
-class EOFError : public std::exception {};
+  std::vector<BenchResult> results;
+  results.push_back(bench_kernel("Board::shift", shifted.size(), reps, min_ms, [&] {
+        unsigned long long sink = 0;
+        for (const auto & s : shifted) {
+          auto board = s.before;
+          board.shift(s.move);
+          const auto & after = board;
+          sink += after[{0, 0}].value();
+        }
+        return sink;
+      }));
+  results.push_back(bench_kernel("Board::can_shift", boards.size() * 4, reps, min_ms, [&] {
+        unsigned long long sink = 0;
+        for (const auto & board : boards) {
+          for (auto move : moves) sink += board.can_shift(move);
+        }
+        return sink;
+      }));
+  results.push_back(bench_kernel("game_is_over", boards.size(), reps, min_ms, [&] {
+        unsigned long long sink = 0;
+        for (const auto & board : boards) sink += game_is_over(board);
+        return sink;
+      }));
+  results.push_back(bench_kernel("placements", shifted.size(), reps, min_ms, [&] {
+        unsigned long long sink = 0;
+        for (const auto & s : shifted) {
+          sink += possible_computer_card_placements_post_shift(s.after, s.move).size();
+        }
+        return sink;
+      }));
+  results.push_back(bench_kernel("compute_board_friction", boards.size(), reps, min_ms, [&] {
+        unsigned long long sink = 0;
+        for (const auto & board : boards) sink += compute_board_friction(board);
+        return sink;
+      }));
+  results.push_back(bench_kernel("BitBoard::shifted", bitboards.size() * 4, reps, min_ms, [&] {
+        unsigned long long sink = 0;
+        for (const auto & board : bitboards) {
+          for (auto move : moves) sink += board.shifted(move).cells;
+        }
+        return sink;
+      }));
+  results.push_back(bench_kernel("leaf_features", bitboards.size(), reps, min_ms, [&] {
+        unsigned long long sink = 0;
+        for (const auto & board : bitboards) sink += leaf_features(board).friction;
+        return sink;
+      }));
+  results.push_back(bench_kernel("table_board_evaluator", bitboards.size(), reps, min_ms, [&] {
+        unsigned long long sink = 0;
+        for (const auto & board : bitboards) sink += table_board_evaluator(board);
+        return sink;
+      }));
+
+  // a whole search is long enough to time once per repetition
+  TranspositionTable tt(16);
+  unsigned long long nodes = 0;
+  double seconds = 0;
+  auto search_result = bench_kernel("search depth " + std::to_string(depth), boards.size(),
+                                    reps, 0, [&] {
+        unsigned long long sink = 0;
+        for (const auto & board : boards) {
+          tt.clear();
+          SearchContext ctx = {&tt};
+          auto res = search_position(table_board_evaluator, ctx, board,
+                                     {depth, std::chrono::milliseconds(0), 0});
+          nodes += res.nodes;
+          seconds += res.elapsed.count() / 1e6;
+          sink += res.score;
+        }
+        return sink;
+      });
+  search_result.nodes = nodes;
+  search_result.seconds = seconds;
+  results.push_back(search_result);
 
-static
-CardPlacement
-get_card_placement_line(decltype(std::cin) & cin_, bool allow_done) {
-  std::string line;
-  getline(cin_, line);
+  print_bench_results(results, format);
+  return 0;
+}
 
-  if (cin_.eof()) throw EOFError();
+#endif
 
-  if (allow_done && line == "done") throw FinishedEnteringCardPlacement();
+int
+main(int argc, char *argv[]) {
+#ifdef THREES_BENCH
+  return bench_main(argc, argv);
+#endif
 
-  std::istringstream is(line);
-  unsigned card_value;
-  CardPosition pos;
-  is >> card_value >> pos.x >> pos.y;
+  if (argc >= 2 && std::string(argv[1]) == "--check-bitboard") {
+    auto games = argc >= 3 ? std::stoul(argv[2]) : 10000;
+    return check_bitboard(games, 0) ? 0 : 1;
+  }
 
-  if (is.fail() || !Board::is_valid_card_position(pos)) throw InvalidCardPlacementLine();
+  if (argc >= 2 && std::string(argv[1]) == "--check-evaluator") {
+    auto boards = argc >= 3 ? std::stoul(argv[2]) : 100000;
+    return check_evaluator(boards, 0) ? 0 : 1;
+  }
 
-  return { card_value, pos };
-}
+  if (argc >= 2 && std::string(argv[1]) == "--check-symmetry") {
+    auto boards = argc >= 3 ? std::stoul(argv[2]) : 20000;
+    return check_symmetry(boards, 0) ? 0 : 1;
+  }
 
-struct ComputersResponse {
-  CardPlacement card_placement;
-  NextColor next_color;
-};
+  if (argc >= 2 && std::string(argv[1]) == "--check-allocations") {
+#ifdef THREES_COUNT_ALLOCATIONS
+    auto boards = argc >= 3 ? std::stoul(argv[2]) : 1;
+    auto depth = argc >= 4 ? std::stoul(argv[3]) : 7;
+    return check_allocations(boards, depth, 0) ? 0 : 1;
+#else
+    throw std::runtime_error("--check-allocations needs a build with THREES_COUNT_ALLOCATIONS, "
+                             "see make threes-solver-allocations");
+#endif
+  }
 
-class PrintCurrentBoard {
-public:
-  void
-  current_board(const Board & board) {
-    board.print_board(std::cout);
-    std::cout << std::endl;
+  if (argc >= 2 && std::string(argv[1]) == "--compare-reuse") {
+    auto moves = argc >= 3 ? std::stoul(argv[2]) : 100;
+    auto depth = argc >= 4 ? std::stoul(argv[3]) : 5;
+    auto ms = argc >= 5 ? std::stoul(argv[4]) : 0;
+    compare_tree_reuse(moves, {static_cast<unsigned>(depth), std::chrono::milliseconds(ms), 0}, 0);
+    return 0;
   }
-};
 
-class ConsoleGameIO : public PrintCurrentBoard {
-public:
-  static
-  NextColor
-  get_next_color() {
-    while (true) {
-      std::string line;
-      getline(std::cin, line);
-      if (!std::cin) throw std::runtime_error("eof");
+  if (argc >= 2 && std::string(argv[1]) == "--compare-ordering") {
+    auto boards = search_corpus(argc >= 3 ? std::stoul(argv[2]) : 50, 1);
+    auto depth = argc >= 4 ? std::stoul(argv[3]) : 4;
+    compare_search_variants(boards, {
+        fixed_depth_variant("fixed", depth, MoveOrdering::FIXED),
+        fixed_depth_variant("heuristic", depth, MoveOrdering::HEURISTIC),
+      });
+    return 0;
+  }
 
-      switch (line[0]) {
-      case 'r': return NextColor::RED; break;
-      case 'b': return NextColor::BLUE; break;
-      case 'w': return NextColor::WHITE; break;
-      default: {
-        std::cout << "not a valid color, try again" << std::endl;
-        continue;
-      }
-      }
-      break;
-    }
+  if (argc >= 2 && std::string(argv[1]) == "--compare-deck") {
+    auto boards = search_corpus(argc >= 3 ? std::stoul(argv[2]) : 50, 1);
+    auto depth = argc >= 4 ? std::stoul(argv[3]) : 5;
+    compare_search_variants(boards, {
+        fixed_depth_variant("no deck", depth, MoveOrdering::HEURISTIC),
+        deck_variant("deck", depth),
+        deck_variant("deck, +1 ply", depth + 1),
+      });
+    return 0;
   }
 
-  ComputersResponse
-  get_computers_response(const Board & board, PlayerMove pm, bool error) {
-    (void) pm;
-    (void) board;
-    if (error) {
-      std::cout << "Computer could not have moved there, try again" << std::endl;
-    }
-    std::cout << "Where did the computer move?" << std::endl;
-    auto placement = get_card_placement_line(std::cin, false);
+  if (argc >= 2 && std::string(argv[1]) == "--compare-pruning") {
+    auto boards = search_corpus(argc >= 3 ? std::stoul(argv[2]) : 50, 1);
+    auto depth = argc >= 4 ? std::stoul(argv[3]) : 3;
+    ChanceModel none, star1, star2, cutoff;
+    none.pruning = ChancePruning::NONE;
+    star1.pruning = ChancePruning::STAR1;
+    star2.pruning = ChancePruning::STAR2;
+    cutoff.probability_cutoff = 1e-3;
+    compare_search_variants(boards, {
+        expectimax_variant("none", depth, none),
+        expectimax_variant("star1", depth, star1),
+        expectimax_variant("star2", depth, star2),
+        expectimax_variant("cutoff", depth, cutoff),
+        expectimax_variant("cutoff+1", depth + 1, cutoff),
+        fixed_depth_variant("minimax", depth, MoveOrdering::HEURISTIC),
+      });
+    return 0;
+  }
 
-    std::cout << "What is the next Color?" << std::endl;
-    auto next_color = get_next_color();
+  if (argc >= 2 && std::string(argv[1]) == "--compare-drivers") {
+    auto boards = search_corpus(argc >= 3 ? std::stoul(argv[2]) : 50, 1);
+    auto depth = argc >= 4 ? std::stoul(argv[3]) : 4;
+    compare_search_variants(boards, {
+        driver_variant("alphabeta", depth, SearchDriver::ALPHABETA, true),
+        driver_variant("pvs", depth, SearchDriver::PVS, true),
+        driver_variant("mtd(f)", depth, SearchDriver::MTDF, true),
+        driver_variant("alphabeta, no tt", depth, SearchDriver::ALPHABETA, false),
+      });
+    return 0;
+  }
 
-    return {placement, next_color};
+  if (argc >= 2 && std::string(argv[1]) == "--compare-selectivity") {
+    auto boards = search_corpus(argc >= 3 ? std::stoul(argv[2]) : 50, 1);
+    auto depth = argc >= 4 ? std::stoul(argv[3]) : 4;
+    Selectivity full, lmr1, lmr2, lmr_late, futile, futile5, futile10, both;
+    lmr1.lmr_depth = lmr2.lmr_depth = lmr_late.lmr_depth = both.lmr_depth = 3;
+    lmr2.lmr_reduction = 2;
+    lmr_late.lmr_moves = 2;
+    futile.futility_depth = futile5.futility_depth = both.futility_depth = 1;
+    futile10.futility_depth = 2;
+    futile5.futility_margin = both.futility_margin = -5;
+    futile10.futility_margin = -10;
+    compare_search_variants(boards, {
+        selective_variant("full", depth, full),
+        selective_variant("lmr", depth, lmr1),
+        selective_variant("lmr, 2 plies", depth, lmr2),
+        selective_variant("lmr after 2", depth, lmr_late),
+        selective_variant("futility", depth, futile),
+        selective_variant("futility -5%", depth, futile5),
+        selective_variant("futility 2 -10%", depth, futile10),
+        selective_variant("lmr+futility", depth, both),
+      });
+    return 0;
   }
-};
 
-class VirtualGameIO : public PrintCurrentBoard {
-public:
-  ComputersResponse
-  get_computers_response(const Board & board, PlayerMove pm, bool error) const {
-    (void) error;
-    static int counter_ = 0;
-    assert(!error);
-    auto toret = possible_computer_card_placements_post_shift(board, pm);
-    auto placement = toret[std::max(0, std::rand()) % toret.size()];
+  if (argc >= 2 && std::string(argv[1]) == "--compare-parallel") {
+    auto boards = search_corpus(argc >= 3 ? std::stoul(argv[2]) : 50, 1);
+    auto depth = argc >= 4 ? std::stoul(argv[3]) : 5;
+    auto threads = argc >= 5 ? std::stoul(argv[4]) : std::max(2u, std::thread::hardware_concurrency());
+    compare_search_variants(boards, {
+        fixed_depth_variant("serial", depth, MoveOrdering::HEURISTIC),
+        parallel_variant("swipes", depth, threads, RootSplit::SWIPES),
+        parallel_variant("placements", depth, threads, RootSplit::PLACEMENTS),
+      });
+    return 0;
+  }
 
-    NextColor next_color;
-    switch (counter_++ % 3) {
-    case 0: next_color = NextColor::BLUE; break;
-    case 1: next_color = NextColor::RED; break;
-    case 2: next_color = NextColor::WHITE; break;
-    default: assert(false); next_color = NextColor::WHITE;
+  if (argc >= 2 && std::string(argv[1]) == "--smp-bench") {
+    auto boards = search_corpus(argc >= 3 ? std::stoul(argv[2]) : 30, 1);
+    auto depth = argc >= 4 ? std::stoul(argv[3]) : 5;
+    std::vector<SearchVariant> variants;
+    for (unsigned threads : {1, 2, 4, 8, 16}) {
+      auto name = std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+      variants.push_back(lazy_smp_variant(name, depth, threads));
     }
-
-    return {placement, next_color};
+    std::cout << "lazy smp at depth " << depth << " on " << boards.size() << " positions, "
+              << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    compare_search_variants(boards, variants);
+    return 0;
   }
-};
 
-template<class GameIO>
-void
-run_game(Board board, GameIO gio) {
-  while (true) {
-    gio.current_board(board);
+  SolverOptions options;
+  bool depth_given = false;
+  bool interactive = false;
+  bool track_deck = false;
+  unsigned self_play = 0;
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  unsigned long long seed = 0;
+  auto stats_format = StatsFormat::TEXT;
+  std::string search_stats_path;
+  const char *batch_path = nullptr;
+  const char *board_path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next_arg = [&] () -> std::string {
+      if (i + 1 >= argc) throw std::runtime_error("missing value for " + arg);
+      return argv[++i];
+    };
 
-    if (game_is_over(board)) {
-      throw std::runtime_error("game over!");
+    if (arg == "--depth") {
+      options.limits.max_depth = std::stoul(next_arg());
+      if (options.limits.max_depth > MAX_SEARCH_DEPTH) {
+        throw std::runtime_error("--depth can be at most " + std::to_string(MAX_SEARCH_DEPTH));
+      }
+      depth_given = true;
     }
+    else if (arg == "--time") options.limits.time_limit = std::chrono::milliseconds(std::stoul(next_arg()));
+    else if (arg == "--nodes") options.limits.node_limit = std::stoull(next_arg());
+    else if (arg == "--search-info") options.print_search_info = true;
+    else if (arg == "--ordering") {
+      auto ordering = next_arg();
+      if (ordering == "fixed") options.ordering = MoveOrdering::FIXED;
+      else if (ordering == "heuristic") options.ordering = MoveOrdering::HEURISTIC;
+      else throw std::runtime_error("bad move ordering: " + ordering);
+    }
+    else if (arg == "--driver") {
+      auto driver = next_arg();
+      if (driver == "alphabeta") options.driver = SearchDriver::ALPHABETA;
+      else if (driver == "pvs") options.driver = SearchDriver::PVS;
+      else if (driver == "mtdf") options.driver = SearchDriver::MTDF;
+      else throw std::runtime_error("bad search driver: " + driver);
+    }
+    else if (arg == "--engine") {
+      auto engine = next_arg();
+      if (engine == "minimax") options.engine = SearchEngine::MINIMAX;
+      else if (engine == "expectimax") options.engine = SearchEngine::EXPECTIMAX;
+      else throw std::runtime_error("bad search engine: " + engine);
+    }
+    else if (arg == "--pruning") {
+      auto pruning = next_arg();
+      if (pruning == "none") options.chance.pruning = ChancePruning::NONE;
+      else if (pruning == "star1") options.chance.pruning = ChancePruning::STAR1;
+      else if (pruning == "star2") options.chance.pruning = ChancePruning::STAR2;
+      else throw std::runtime_error("bad chance pruning: " + pruning);
+    }
+    else if (arg == "--probability-cutoff") options.chance.probability_cutoff = std::stod(next_arg());
+    else if (arg == "--color-odds") {
+      options.chance.red = std::stod(next_arg());
+      options.chance.blue = std::stod(next_arg());
+      options.chance.white = std::stod(next_arg());
+      if (options.chance.red < 0 || options.chance.blue < 0 || options.chance.white < 0 ||
+          !(options.chance.red + options.chance.blue + options.chance.white > 0)) {
+        throw std::runtime_error("bad color odds");
+      }
+    }
+    else if (arg == "--bonus-odds") options.chance.bonus_card = std::stod(next_arg());
+    else if (arg == "--threads") {
+      options.threads = std::stoul(next_arg());
+      if (!options.threads) throw std::runtime_error("--threads needs at least one thread");
+    }
+    else if (arg == "--parallel") {
+      auto parallel = next_arg();
+      if (parallel == "root") options.parallel = ParallelMode::ROOT;
+      else if (parallel == "lazy-smp") options.parallel = ParallelMode::LAZY_SMP;
+      else throw std::runtime_error("bad parallel mode: " + parallel);
+    }
+    else if (arg == "--split") {
+      auto split = next_arg();
+      if (split == "swipes") options.split = RootSplit::SWIPES;
+      else if (split == "placements") options.split = RootSplit::PLACEMENTS;
+      else throw std::runtime_error("bad root split: " + split);
+    }
+    else if (arg == "--no-symmetry") options.symmetry = false;
+    else if (arg == "--no-reuse") options.reuse_tree = false;
+    else if (arg == "--no-batch") options.batch_leaves = false;
+    else if (arg == "--lmr") options.selectivity.lmr_depth = std::stoul(next_arg());
+    else if (arg == "--lmr-moves") options.selectivity.lmr_moves = std::stoul(next_arg());
+    else if (arg == "--lmr-reduction") options.selectivity.lmr_reduction = std::stoul(next_arg());
+    else if (arg == "--futility") options.selectivity.futility_depth = std::stoul(next_arg());
+    else if (arg == "--futility-margin") options.selectivity.futility_margin = std::stoi(next_arg());
+    else if (arg == "--tt-size") {
+      options.tt_size = std::stoul(next_arg());
+      unsigned max_tt_size = TranspositionTable::MAX_LOG2_BUCKETS;
+      if (options.tt_size > max_tt_size) {
+        throw std::runtime_error("--tt-size is log2 of the buckets, at most " +
+                                 std::to_string(max_tt_size));
+      }
+    }
+    else if (arg == "--no-tt") options.tt_size = 0;
+    else if (arg == "--tt-stats") options.print_tt_stats = true;
+    else if (arg == "--search-stats") {
+#ifdef THREES_SEARCH_STATS
+      search_stats_path = next_arg();
+#else
+      throw std::runtime_error("--search-stats needs a build with THREES_SEARCH_STATS, "
+                               "see make threes-solver-stats");
+#endif
+    }
+    else if (arg == "--deck") track_deck = true;
+    else if (arg == "--ponder") options.ponder = true;
+    else if (arg == "--interactive") interactive = true;
+    else if (arg == "--self-play") self_play = std::stoul(next_arg());
+    else if (arg == "--batch") {
+      next_arg();
+      batch_path = argv[i];
+    }
+    else if (arg == "--jobs") jobs = std::max(1ul, std::stoul(next_arg()));
+    else if (arg == "--seed") seed = std::stoull(next_arg());
+    else if (arg == "--stats") {
+      auto format = next_arg();
+      if (format == "text") stats_format = StatsFormat::TEXT;
+      else if (format == "csv") stats_format = StatsFormat::CSV;
+      else if (format == "json") stats_format = StatsFormat::JSON;
+      else throw std::runtime_error("bad stats format: " + format);
+    }
+    else if (!board_path && arg.compare(0, 2, "--")) board_path = argv[i];
+    else throw std::runtime_error("bad argument: " + arg);
+  }
 
-    auto player_move = run_minimax(board_evaluator, board, 6);
-
-    board.shift(player_move);
+  // with a budget, search as deep as it allows unless told otherwise
+  if (!depth_given && (options.limits.time_limit.count() || options.limits.node_limit)) {
+    options.limits.max_depth = 0;
+  }
+  if (!options.limits.max_depth && !options.limits.time_limit.count() && !options.limits.node_limit) {
+    throw std::runtime_error("need a depth, time or node limit");
+  }
+  if (options.threads > 1 && options.engine != SearchEngine::MINIMAX) {
+    throw std::runtime_error("only the minimax engine can use more than one thread");
+  }
+  if (options.threads > 1 && options.parallel == ParallelMode::ROOT &&
+      options.driver == SearchDriver::MTDF) {
+    throw std::runtime_error("mtd(f) can't split the root between threads, use lazy smp");
+  }
+  if (options.threads > 1 && options.parallel == ParallelMode::LAZY_SMP && !options.tt_size) {
+    throw std::runtime_error("lazy smp needs a transposition table");
+  }
 
-    bool error = false;
-    while (true) {
-      auto cr = gio.get_computers_response(board, player_move, error);
+#ifdef THREES_SEARCH_STATS
+  std::ofstream search_stats_file;
+  if (search_stats_path == "-") options.search_stats = &std::cerr;
+  else if (!search_stats_path.empty()) {
+    search_stats_file.open(search_stats_path);
+    if (!search_stats_file) throw std::runtime_error("can't write " + search_stats_path);
+    options.search_stats = &search_stats_file;
+  }
+#endif
 
-      try {
-        board.computers_move(player_move, cr.card_placement, cr.next_color);
-      }
-      catch (...) {
-        error = true;
-        continue;
-      }
+  if (self_play) {
+    if (options.ponder) throw std::runtime_error("--self-play has no opponent to ponder over");
+    if (interactive) throw std::runtime_error("--self-play plays against itself, not --interactive");
+    run_self_play(options, self_play, jobs, seed, track_deck, stats_format);
+    return 0;
+  }
 
-      break;
+  if (batch_path) {
+    if (options.threads > 1 || options.ponder) {
+      throw std::runtime_error("--batch searches every board on one thread, see --jobs");
     }
+    if (std::string(batch_path) == "-") run_batch(options, std::cin, jobs, track_deck, stats_format);
+    else {
+      std::ifstream batch_file(batch_path);
+      if (!batch_file) throw std::runtime_error(std::string("can't read ") + batch_path);
+      run_batch(options, batch_file, jobs, track_deck, stats_format);
+    }
+    return 0;
   }
-}
 
-int
-main(int argc, char *argv[]) {
   // get initial board state
   std::istream *is = nullptr;
-  if (argc != 2) {
+  if (!board_path) {
     std::cout << "Enter Initial State" << std::endl;
     is = &std::cin;
   }
   else {
-    is = new std::ifstream(argv[1]);
+    is = new std::ifstream(board_path);
   }
 
   auto board = read_board_from_human_input(*is);
+  if (track_deck) board.set_deck(starting_deck(board));
 
-  //  run_game(board, ConsoleGameIO());
-  run_game(board, VirtualGameIO());
+  auto res = (interactive
+              ? run_game(board, ConsoleGameIO(), options)
+              : run_game(board, VirtualGameIO(unsigned(seed)), options));
+  std::cout << "game over after " << res.moves << " moves, score "
+            << game_score(res.board) << std::endl;
 
   return 0;
 }